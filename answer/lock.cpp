@@ -34,8 +34,10 @@ void lockAcquired(const char* lockId, Thread* thread) {
 }
 
 void lockFailed(const char* lockId, Thread* thread) {
-    // inform that this lock is gone
-    REMOVE_FROM_MAP(const char*, sharedLockThreadMap, lockId);
+    // a timed out attempt leaves the lock as it is; otherwise it is gone
+    if (!lockExists(lockId)) {
+        REMOVE_FROM_MAP(const char*, sharedLockThreadMap, lockId);
+    }
     // this thread is not attempting this lock any more
     bool isAttemptingLock = MAP_CONTAINS(Thread*, sharedLockAttemptMap, thread);
     if (isAttemptingLock) {
@@ -48,8 +50,11 @@ void lockFailed(const char* lockId, Thread* thread) {
 }
 
 void lockReleased(const char* lockId, Thread* thread) {
-    // priority inversion
-    thread->priority = thread->originalPriority;
+    // priority inversion; locks may also be released outside of any simulated
+    // thread, e.g. by the main thread before the system is started
+    if (thread != NULL) {
+        setThreadPriority(thread, thread->originalPriority);
+    }
     // restore initial value for lock in sharedLockThreadMap
     PUT_IN_MAP(const char*, sharedLockThreadMap, lockId, NULL);
 }
@@ -59,7 +64,8 @@ void lockReleased(const char* lockId, Thread* thread) {
 #pragma region Lock Functions
 
 Thread* getThreadHoldingLock(const char* lockId) {
-    return (Thread*)GET_FROM_MAP(const char*, sharedLockThreadMap, lockId);
+    // uncontended locks never reach lockAcquired, so ask the framework
+    return getLockHolder(lockId);
 }
 
 #pragma endregion
\ No newline at end of file
@@ -66,17 +66,18 @@ Thread* createAndSetThreadToRun(const char* name,
                                 void* (*func)(void*),
                                 void* arg,
                                 int pri) {
-    Thread* ret = (Thread*)malloc(sizeof(Thread));
-    ret->name = (char*)malloc(strlen(name) + 1);
-    strcpy(ret->name, name);
+    Thread* ret = allocateThread(name);
     ret->func = func;
     ret->arg = arg;
     ret->priority = pri;
     ret->originalPriority = pri;
 
-    createThread(ret);
-    // insert created thread to ready list, making ready list a priority queue
-    insertToReadyList(ret);
+    // the framework hands the thread back through threadReady, which inserts
+    // it to ready list
+    if (!createThread(ret)) {
+        freeThread(ret);
+        return NULL;
+    }
     return ret;
 }
 
@@ -85,8 +86,7 @@ void destroyThread(Thread* thread) {
     sprintf(line, "[destroyThread] destroying thread with name %s\n",
             thread->name);
     verboseLog(line);
-    free(thread->name);
-    free(thread);
+    freeThread(thread);
 }
 
 Thread* nextThreadToRun(int currentTick) {
@@ -142,24 +142,43 @@ int tickSleep(int numTicks) {
         getCurrentTick();  // start tick is the tick when the function is called
     wakeTick = startTick + numTicks;  // wake tick is calculated
 
-    // find current thread
-    Thread* curThread = getCurrentThread();
-
-    // remove thread from ready list
-    removeFromList(readyList, (void*)curThread);
-    // add [curThread, wakeTick] to sleepThreadMap
-    PUT_IN_MAP(Thread*, sleepThreadMap, curThread, (void*)&wakeTick);
-    // add thread to sleep list
-    insertToSleepList(curThread);
-
-    // stop executing
-    stopExecutingThreadForCycle();
+    // stop executing until wake tick, the framework calls threadBlocked
+    blockCurrentThread(wakeTick);
 
     return startTick;
 }
 
 void setMyPriority(int priority) {
-    getCurrentThread()->priority = priority;
+    // the framework calls threadPriorityChanged to reposition the thread
+    setThreadPriority(getCurrentThread(), priority);
+}
+
+void threadReady(Thread* thread) {
+    insertToReadyList(thread);
+}
+
+void threadBlocked(Thread* thread, int wakeTick) {
+    // remove thread from ready list
+    removeFromList(readyList, (void*)thread);
+    // a thread waiting for a lock is not sleeping, threadReady brings it back
+    if (wakeTick == NO_WAKE_TICK) {
+        return;
+    }
+    // add [thread, wakeTick] to sleepThreadMap
+    PUT_IN_MAP(Thread*, sleepThreadMap, thread, (void*)(long)wakeTick);
+    // add thread to sleep list
+    insertToSleepList(thread);
+}
+
+void threadPriorityChanged(Thread* thread, int) {
+    // both lists are ordered by priority, so move the thread to its new place
+    if (listGet(readyList, (void*)thread) != NULL) {
+        removeFromList(readyList, (void*)thread);
+        insertToReadyList(thread);
+    } else if (listGet(sleepList, (void*)thread) != NULL) {
+        removeFromList(sleepList, (void*)thread);
+        insertToSleepList(thread);
+    }
 }
 
 /*
@@ -183,17 +202,18 @@ void insertToReadyList(Thread* thread) {
 }
 
 void insertToSleepList(Thread* thread) {
-    int* wakeTick = (int*)GET_FROM_MAP(Thread*, sleepThreadMap, thread);
+    int wakeTick = (int)(long)GET_FROM_MAP(Thread*, sleepThreadMap, thread);
     int threadIndex = 0;
     Thread* curThread = NULL;  // to iterate sleep list
-    int* curWakeTick = NULL;
+    int curWakeTick = 0;
     // insert thread before the first thread in sleep list with later wake tick
     // or with equal wake tick but lower priority
     while (threadIndex < listSize(sleepList)) {
         curThread = (Thread*)listGet(sleepList, threadIndex);
-        curWakeTick = (int*)GET_FROM_MAP(Thread*, sleepThreadMap, curThread);
-        if (*wakeTick < *curWakeTick ||
-            *wakeTick == *curWakeTick &&
+        curWakeTick =
+            (int)(long)GET_FROM_MAP(Thread*, sleepThreadMap, curThread);
+        if (wakeTick < curWakeTick ||
+            wakeTick == curWakeTick &&
                 thread->priority > curThread->priority) {
             break;
         }
@@ -205,14 +225,14 @@ void insertToSleepList(Thread* thread) {
 void updateReadyAndSleepLists(int currentTick) {
     int sleepCnt = listSize(sleepList);
     Thread* candidate = NULL;
-    int* wakeTick = NULL;
+    int wakeTick = 0;
     // always check the first thread in sleep list
     // if wake tick smaller than current tick, remove from sleep list and sleep
     // map and add to ready list otherwise break
     while (sleepCnt > 0) {
         candidate = (Thread*)listGet(sleepList, 0);
-        wakeTick = (int*)GET_FROM_MAP(Thread*, sleepThreadMap, candidate);
-        if (*wakeTick <= currentTick) {
+        wakeTick = (int)(long)GET_FROM_MAP(Thread*, sleepThreadMap, candidate);
+        if (wakeTick <= currentTick) {
             // if find a thread with wake tick earlier than current tick
             // should wake up this thread
             // remove it from sleep list and sleep map and add it to ready list
@@ -0,0 +1,54 @@
+#include "bench_helper.h"
+#include <List.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "threading/ThreadManager.h"
+
+extern const char* readyList;
+extern const char* sleepList;
+
+void initializeBenchmarkSimulator() {
+    static bool initialized = false;
+    if (!initialized) {
+        Threading::ThreadManager::getInstance();
+        initializeCallback();
+        initialized = true;
+    }
+}
+
+Thread* createBenchmarkThread(int index, int pri) {
+    char name[32];
+    sprintf(name, "Bench %d", index);
+    Thread* ret = allocateThread(name);
+    ret->priority = pri;
+    ret->originalPriority = pri;
+    return ret;
+}
+
+Thread** fillReadyList(int count) {
+    initializeBenchmarkSimulator();
+    Thread** threads = (Thread**)malloc(sizeof(Thread*) * count);
+    int span = MAX_PRI - MIN_PRI + 1;
+    // Appending in descending priority keeps the list in the same order
+    // insertToReadyList would produce without paying its quadratic cost here.
+    for (int x = 0; x < count; x++) {
+        int pri = MAX_PRI - (int)((long)x * span / count);
+        threads[x] = createBenchmarkThread(x, pri);
+        addToList(readyList, (void*)threads[x]);
+    }
+    return threads;
+}
+
+void destroyBenchmarkThreads(Thread** threads, int count) {
+    while (listSize(readyList) > 0) {
+        removeFromListAtIndex(readyList, listSize(readyList) - 1);
+    }
+    while (listSize(sleepList) > 0) {
+        removeFromListAtIndex(sleepList, listSize(sleepList) - 1);
+    }
+    for (int x = 0; x < count; x++) {
+        destroyThread(threads[x]);
+    }
+    free(threads);
+}
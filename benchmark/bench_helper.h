@@ -0,0 +1,39 @@
+#ifndef PROJECT2_THREADING_BENCHHELPER_H
+#define PROJECT2_THREADING_BENCHHELPER_H
+
+#include "Thread.h"
+
+/**
+ * Creates the thread manager, logger and the structures owned by the answer
+ * without starting the idle thread. Safe to call from every benchmark.
+ */
+void initializeBenchmarkSimulator();
+
+/**
+ * Allocates a thread record that is never handed to the simulator. The
+ * scheduler only looks at the fields so these are enough to fill its lists.
+ *
+ * @param index Used to build a unique name.
+ * @param pri The priority of the thread.
+ * @return The new thread, free it with destroyThread.
+ */
+Thread* createBenchmarkThread(int index, int pri);
+
+/**
+ * Fills the ready list with count threads, highest priority first, spreading
+ * them over the whole priority range.
+ *
+ * @param count The number of threads to create.
+ * @return An array of count threads, free it with destroyBenchmarkThreads.
+ */
+Thread** fillReadyList(int count);
+
+/**
+ * Empties the ready and sleep lists and frees the given threads.
+ *
+ * @param threads Threads returned by fillReadyList.
+ * @param count The number of threads.
+ */
+void destroyBenchmarkThreads(Thread** threads, int count);
+
+#endif  // PROJECT2_THREADING_BENCHHELPER_H
@@ -0,0 +1,476 @@
+#include <List.h>
+#include <Lock.h>
+#include <Map.h>
+#include <Thread.h>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "bench_helper.h"
+#include "benchmark/benchmark.h"
+#include "threading/EventQueue.h"
+#include "threading/InternalThread.h"
+#include "threading/ScanKernels.h"
+#include "threading/ThreadRegistry.h"
+
+extern const char* readyList;
+extern const char* sleepList;
+extern const char* sleepThreadMap;
+
+void insertToSleepList(Thread* thread);
+void updateReadyAndSleepLists(int currentTick);
+
+#pragma region Scheduler
+
+static void BM_NextThreadToRun(benchmark::State& state) {
+    int numThreads = state.range(0);
+    Thread** threads = fillReadyList(numThreads);
+    int tick = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(nextThreadToRun(++tick));
+    }
+    state.SetComplexityN(numThreads);
+    destroyBenchmarkThreads(threads, numThreads);
+}
+BENCHMARK(BM_NextThreadToRun)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000)
+    ->Complexity();
+
+/**
+ * Builds a sleep list of count threads waking on ticks 1..count.
+ */
+static Thread** fillSleepList(int count) {
+    initializeBenchmarkSimulator();
+    Thread** threads = (Thread**)malloc(sizeof(Thread*) * count);
+    for (long x = 0; x < count; x++) {
+        threads[x] = createBenchmarkThread(x, DEFAULT_PRI);
+        PUT_IN_MAP(Thread*, sleepThreadMap, threads[x], (void*)(x + 1));
+        addToList(sleepList, (void*)threads[x]);
+    }
+    return threads;
+}
+
+static void emptySleepThreadMap(Thread** threads, int count) {
+    for (int x = 0; x < count; x++) {
+        REMOVE_FROM_MAP(Thread*, sleepThreadMap, threads[x]);
+    }
+}
+
+// Worst case insertion: the new sleeper wakes after everybody else.
+static void BM_InsertToSleepList(benchmark::State& state) {
+    int numThreads = state.range(0);
+    Thread** threads = fillSleepList(numThreads);
+    Thread* sleeper = createBenchmarkThread(numThreads, DEFAULT_PRI);
+    long wakeTick = numThreads + 1;
+    PUT_IN_MAP(Thread*, sleepThreadMap, sleeper, (void*)wakeTick);
+    for (auto _ : state) {
+        insertToSleepList(sleeper);
+        removeFromListAtIndex(sleepList, numThreads);
+    }
+    state.SetComplexityN(numThreads);
+    REMOVE_FROM_MAP(Thread*, sleepThreadMap, sleeper);
+    destroyThread(sleeper);
+    emptySleepThreadMap(threads, numThreads);
+    destroyBenchmarkThreads(threads, numThreads);
+}
+BENCHMARK(BM_InsertToSleepList)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000)
+    ->Complexity();
+
+// Puts a thread to sleep at the head of the list and wakes it on the same
+// tick, which is the path every tickSleep(0)-style wakeup takes.
+static void BM_SleepAndWake(benchmark::State& state) {
+    int numThreads = state.range(0);
+    Thread** threads = fillSleepList(numThreads);
+    Thread* sleeper = createBenchmarkThread(numThreads, DEFAULT_PRI);
+    long wakeTick = 0;
+    for (auto _ : state) {
+        PUT_IN_MAP(Thread*, sleepThreadMap, sleeper, (void*)wakeTick);
+        insertToSleepList(sleeper);
+        updateReadyAndSleepLists(wakeTick);
+        removeFromListAtIndex(readyList, 0);
+    }
+    state.SetComplexityN(numThreads);
+    destroyThread(sleeper);
+    emptySleepThreadMap(threads, numThreads);
+    destroyBenchmarkThreads(threads, numThreads);
+}
+BENCHMARK(BM_SleepAndWake)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000)
+    ->Complexity();
+
+#pragma endregion
+
+#pragma region Structures
+
+static const char* fillList(int count) {
+    initializeBenchmarkSimulator();
+    const char* list = createNewList();
+    for (long x = 0; x < count; x++) {
+        addToList(list, (void*)x);
+    }
+    return list;
+}
+
+static void BM_ListAppendRemove(benchmark::State& state) {
+    int size = state.range(0);
+    const char* list = fillList(size);
+    for (auto _ : state) {
+        addToList(list, (void*)&size);
+        benchmark::DoNotOptimize(removeFromListAtIndex(list, size));
+    }
+    destroyList(list);
+}
+BENCHMARK(BM_ListAppendRemove)->RangeMultiplier(10)->Range(10, 100000);
+
+static void BM_ListInsertRemoveHead(benchmark::State& state) {
+    int size = state.range(0);
+    const char* list = fillList(size);
+    for (auto _ : state) {
+        addToListAtIndex(list, 0, (void*)&size);
+        benchmark::DoNotOptimize(removeFromListAtIndex(list, 0));
+    }
+    state.SetComplexityN(size);
+    destroyList(list);
+}
+BENCHMARK(BM_ListInsertRemoveHead)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000)
+    ->Complexity();
+
+static void BM_ListGet(benchmark::State& state) {
+    int size = state.range(0);
+    const char* list = fillList(size);
+    int index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(listGet(list, index));
+        index = (index + 1) % size;
+    }
+    destroyList(list);
+}
+BENCHMARK(BM_ListGet)->RangeMultiplier(10)->Range(10, 100000);
+
+static void BM_ListRemoveByValue(benchmark::State& state) {
+    int size = state.range(0);
+    const char* list = fillList(size);
+    for (auto _ : state) {
+        addToList(list, (void*)&size);
+        removeFromList(list, (void*)&size);
+    }
+    state.SetComplexityN(size);
+    destroyList(list);
+}
+BENCHMARK(BM_ListRemoveByValue)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000)
+    ->Complexity();
+
+static bool ascending(void* first, void* second) {
+    return (long)first < (long)second;
+}
+
+static bool descending(void* first, void* second) {
+    return (long)first > (long)second;
+}
+
+// Alternating the order makes every iteration do a full reversal.
+static void BM_ListSort(benchmark::State& state) {
+    int size = state.range(0);
+    const char* list = fillList(size);
+    bool up = false;
+    for (auto _ : state) {
+        sortList(list, up ? ascending : descending);
+        up = !up;
+    }
+    state.SetComplexityN(size);
+    destroyList(list);
+}
+BENCHMARK(BM_ListSort)->RangeMultiplier(10)->Range(10, 100000)->Complexity();
+
+static const char* fillMap(int count) {
+    initializeBenchmarkSimulator();
+    const char* map = CREATE_MAP(long);
+    for (long x = 0; x < count; x++) {
+        PUT_IN_MAP(long, map, x, (void*)x);
+    }
+    return map;
+}
+
+static void BM_MapPutRemove(benchmark::State& state) {
+    int size = state.range(0);
+    const char* map = fillMap(size);
+    long key = size;
+    for (auto _ : state) {
+        PUT_IN_MAP(long, map, key, (void*)key);
+        void* value = REMOVE_FROM_MAP(long, map, key);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetComplexityN(size);
+    MapManager<long>::getInstance()->destroy(map);
+}
+BENCHMARK(BM_MapPutRemove)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000)
+    ->Complexity();
+
+static void BM_MapGet(benchmark::State& state) {
+    int size = state.range(0);
+    const char* map = fillMap(size);
+    long key = 0;
+    for (auto _ : state) {
+        void* value = GET_FROM_MAP(long, map, key);
+        benchmark::DoNotOptimize(value);
+        key = (key + 1) % size;
+    }
+    state.SetComplexityN(size);
+    MapManager<long>::getInstance()->destroy(map);
+}
+BENCHMARK(BM_MapGet)->RangeMultiplier(10)->Range(10, 100000)->Complexity();
+
+static void BM_MapContains(benchmark::State& state) {
+    int size = state.range(0);
+    const char* map = fillMap(size);
+    long key = 0;
+    for (auto _ : state) {
+        bool found = MAP_CONTAINS(long, map, key);
+        benchmark::DoNotOptimize(found);
+        key = (key + 1) % (2 * size);
+    }
+    state.SetComplexityN(size);
+    MapManager<long>::getInstance()->destroy(map);
+}
+BENCHMARK(BM_MapContains)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000)
+    ->Complexity();
+
+#pragma endregion
+
+#pragma region Locks
+
+// Locks are called from the benchmark threads rather than simulated threads,
+// so no scheduling happens; this is the bookkeeping cost of lock and unlock.
+static const char* benchmarkLock() {
+    static const char* lockId = NULL;
+    if (lockId == NULL) {
+        initializeBenchmarkSimulator();
+        lockId = createLock();
+    }
+    return lockId;
+}
+
+static void BM_LockUncontended(benchmark::State& state) {
+    const char* lockId = benchmarkLock();
+    for (auto _ : state) {
+        ::lock(lockId);
+        ::unlock(lockId);
+    }
+}
+BENCHMARK(BM_LockUncontended);
+
+static volatile bool holderRunning;
+static volatile bool lockHeld;
+
+// Takes the lock and keeps it until the benchmark is done with it.
+static void* holdLock(void* lockId) {
+    ::lock((const char*)lockId);
+    lockHeld = true;
+    while (holderRunning) {
+    }
+    ::unlock((const char*)lockId);
+    return NULL;
+}
+
+// Another simulated thread holds the lock, so every attempt finds it taken;
+// this is what a contended lock costs before the caller would block.
+static void BM_LockContended(benchmark::State& state) {
+    const char* lockId = benchmarkLock();
+    Thread* holderThread = allocateThread("Holder");
+    holderRunning = true;
+    lockHeld = false;
+    Threading::InternalThread holder(holdLock, (void*)lockId, holderThread);
+    holder.start();
+    while (!lockHeld) {
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tryLock(lockId));
+    }
+    holderRunning = false;
+    holder.join();
+    freeThread(holderThread);
+}
+BENCHMARK(BM_LockContended);
+
+static const char* createBenchmarkReadWriteLock() {
+    initializeBenchmarkSimulator();
+    return createReadWriteLock(false);
+}
+
+// Readers never wait for each other, so this should scale with the number of
+// threads.
+static void BM_SharedLockContended(benchmark::State& state) {
+    static const char* lockId = createBenchmarkReadWriteLock();
+    for (auto _ : state) {
+        lockShared(lockId);
+        unlockShared(lockId);
+    }
+}
+BENCHMARK(BM_SharedLockContended)->ThreadRange(2, 8)->UseRealTime();
+
+#pragma endregion
+
+#pragma region Kernels
+
+// Columns shaped like a ThreadTable: priorities over the whole range, wake
+// ticks spread over the next 1000 ticks and a third of the threads in each
+// run state.
+typedef struct KernelColumns {
+    vector<int> priorities;
+    vector<int> wakeTicks;
+    vector<uint8_t> states;
+    vector<int> rows;
+} KernelColumns;
+
+static void fillKernelColumns(KernelColumns* columns, int count) {
+    srand(count);
+    columns->priorities.resize(count);
+    columns->wakeTicks.resize(count);
+    columns->states.resize(count);
+    columns->rows.resize(count);
+    for (int x = 0; x < count; x++) {
+        columns->priorities[x] = MIN_PRI + rand() % (MAX_PRI - MIN_PRI + 1);
+        columns->wakeTicks[x] = rand() % 1000;
+        columns->states[x] = rand() % 3;
+    }
+}
+
+static const Threading::ScanKernels* benchmarkKernels(
+    const benchmark::State& state) {
+    return state.range(1) == 0 ? Threading::scalarScanKernels()
+                               : Threading::bestScanKernels();
+}
+
+// Every size with the scalar loops and with the best kernels.
+static void kernelArgs(benchmark::internal::Benchmark* benchmark) {
+    const int sizes[] = {64, 1024, 65536};
+    for (int x = 0; x < 3; x++) {
+        benchmark->Args({sizes[x], 0});
+        benchmark->Args({sizes[x], 1});
+    }
+}
+
+static void setKernelLabel(benchmark::State& state) {
+    state.SetLabel(benchmarkKernels(state)->name);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_KernelArgmax(benchmark::State& state) {
+    const Threading::ScanKernels* kernels = benchmarkKernels(state);
+    KernelColumns columns;
+    fillKernelColumns(&columns, state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            kernels->argmax(columns.priorities.data(), state.range(0)));
+    }
+    setKernelLabel(state);
+}
+BENCHMARK(BM_KernelArgmax)->Apply(kernelArgs);
+
+static void BM_KernelSelectAtMost(benchmark::State& state) {
+    const Threading::ScanKernels* kernels = benchmarkKernels(state);
+    KernelColumns columns;
+    fillKernelColumns(&columns, state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(kernels->selectAtMost(
+            columns.wakeTicks.data(), columns.states.data(), 1,
+            state.range(0), 10, columns.rows.data()));
+    }
+    setKernelLabel(state);
+}
+BENCHMARK(BM_KernelSelectAtMost)->Apply(kernelArgs);
+
+#pragma endregion
+
+#pragma region Threads
+
+// What createThread and setThreadPriority cost the caller, and what the
+// dispatcher pays to take the event back out.
+static void BM_EventQueuePushPop(benchmark::State& state) {
+    Threading::EventQueue queue;
+    Threading::Event event = {Threading::EVENT_PRIORITY, NULL, DEFAULT_PRI};
+    for (auto _ : state) {
+        queue.push(event);
+        queue.pop(&event);
+    }
+}
+BENCHMARK(BM_EventQueuePushPop);
+
+// Every lock, unlock and getCurrentThread starts with this lookup.
+static void BM_GetCurrentThread(benchmark::State& state) {
+    initializeBenchmarkSimulator();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(getCurrentThread());
+    }
+}
+BENCHMARK(BM_GetCurrentThread)->ThreadRange(1, 8);
+
+// The dispatcher does this lookup every tick it runs a thread.
+static void BM_RegistryFind(benchmark::State& state) {
+    int count = state.range(0);
+    Threading::ThreadRegistry registry;
+    vector<Thread*> threads;
+    for (int x = 0; x < count; x++) {
+        threads.push_back(allocateThread("Bench"));
+        registry.add(threads.back());
+    }
+    int next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(registry.find(threads[next]));
+        next = next + 1 == count ? 0 : next + 1;
+    }
+    for (int x = 0; x < count; x++) {
+        freeThread(threads[x]);
+    }
+}
+BENCHMARK(BM_RegistryFind)->Arg(16)->Arg(1024)->Arg(16384);
+
+// Once the arena has a free record this is a free-list pop and push.
+static void BM_AllocateFreeThread(benchmark::State& state) {
+    for (auto _ : state) {
+        Thread* thread = allocateThread("Bench");
+        benchmark::DoNotOptimize(thread);
+        freeThread(thread);
+    }
+}
+BENCHMARK(BM_AllocateFreeThread);
+
+static volatile bool spinnerRunning;
+
+static void* spin(void*) {
+    while (spinnerRunning) {
+    }
+    return NULL;
+}
+
+// One pause and one resume, which is what every preempted slice costs.
+static void BM_PauseResumeRoundTrip(benchmark::State& state) {
+    initializeBenchmarkSimulator();
+    spinnerRunning = true;
+    Threading::InternalThread thread(spin, NULL);
+    thread.start();
+    for (auto _ : state) {
+        thread.pause();
+        thread.resume();
+    }
+    spinnerRunning = false;
+    thread.join();
+}
+BENCHMARK(BM_PauseResumeRoundTrip)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+#pragma endregion
+
+BENCHMARK_MAIN();
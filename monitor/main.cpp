@@ -0,0 +1,101 @@
+/**
+ * Prints the live counters a simulator run publishes with publishStats or
+ * SIMULATOR_STATS, refreshing until the run ends. Runs in its own process and
+ * never holds the simulator up.
+ *
+ * Run with --help for the available options.
+ */
+
+#include <getopt.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include "StatsPage.h"
+#include "Thread.h"
+
+typedef struct MonitorConfig {
+    const char* name;
+    int intervalMillis;
+    bool once;
+} MonitorConfig;
+
+static MonitorConfig config;
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options] NAME\n"
+            "  NAME            the name given to publishStats or "
+            "SIMULATOR_STATS\n"
+            "  --interval N    milliseconds between refreshes (default %d)\n"
+            "  --once          print the counters once and exit\n",
+            program, config.intervalMillis);
+}
+
+static bool parseArguments(int argc, char** argv) {
+    static struct option options[] = {
+        {"interval", required_argument, NULL, 'i'},
+        {"once", no_argument, NULL, 'o'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    int option;
+    while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (option) {
+            case 'i':
+                config.intervalMillis = atoi(optarg);
+                break;
+            case 'o':
+                config.once = true;
+                break;
+            default:
+                usage(argv[0]);
+                return false;
+        }
+    }
+    if (optind != argc - 1 || config.intervalMillis < 1) {
+        usage(argv[0]);
+        return false;
+    }
+    config.name = argv[optind];
+    return true;
+}
+
+static void printCounters(const StatsPageCounters* counters) {
+    printf("tick %d (%s), %.1f ticks/s\n", counters->tick,
+           counters->running ? "running" : "ended", counters->ticksPerSecond);
+    printf("  threads   ready %d, sleeping %d, blocked %d\n",
+           counters->readyThreads, counters->sleepingThreads,
+           counters->blockedThreads);
+    printf("  switches  %ld, preemptions %ld\n", counters->contextSwitches,
+           counters->preemptions);
+    printf("  ready by priority");
+    for (int priority = MIN_PRI; priority <= MAX_PRI; priority++) {
+        printf(" %d:%d", priority,
+               counters->readyByPriority[priority - MIN_PRI]);
+    }
+    printf("\n  locks     %ld contentions, %lld ticks waited\n",
+           counters->lockContentions, counters->lockWaitTicks);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    config.intervalMillis = 1000;
+    config.once = false;
+    if (!parseArguments(argc, argv))
+        return 2;
+
+    const StatsPage* page = mapStatsPage(config.name);
+    if (page == NULL) {
+        fprintf(stderr, "[monitor] no stats page named %s\n", config.name);
+        return 1;
+    }
+    StatsPageCounters counters;
+    while (true) {
+        readStatsPage(page, &counters);
+        printCounters(&counters);
+        if (config.once || !counters.running)
+            break;
+        usleep(config.intervalMillis * 1000);
+    }
+    unmapStatsPage(page);
+    return 0;
+}
@@ -2,8 +2,7 @@
 #include <iomanip>
 #include <iostream>
 #include "Thread.h"
-
-InternalLogger* InternalLogger::instance = NULL;
+#include "threading/SimulatorContext.h"
 
 InternalLogger::InternalLogger() {
     logStream = new stringstream();
@@ -16,19 +15,22 @@ InternalLogger::~InternalLogger() {
     delete logStream;
 }
 
+// Every run of a simulator starts with a quiet logger at tick 0.
 void InternalLogger::init() {
-    instance = new InternalLogger();
+    InternalLogger& logger = getLogger();
+    logger.verbose = false;
+    logger.tick = 0;
 }
 
 InternalLogger& InternalLogger::getLogger() {
-    return *instance;
+    return *Simulator::current()->logger;
 }
 
 InternalLogger& InternalLogger::eventSink() {
+    InternalLogger& logger = getLogger();
     // Save fill so we can restore it afterwards
-    char fill = (*instance).logStream->fill('0');
-    return (*instance) << std::setw(5) << instance->tick << std::setfill(fill)
-                       << " ";
+    char fill = logger.logStream->fill('0');
+    return logger << std::setw(5) << logger.tick << std::setfill(fill) << " ";
 }
 
 void InternalLogger::flush() {
@@ -8,10 +8,10 @@ using namespace std;
 
 class InternalLogger {
     friend class Threading::ThreadManager;
+    friend struct Simulator;
 
    private:
     stringstream* logStream;
-    static InternalLogger* instance;
     InternalLogger();
     ~InternalLogger();
     static void init();
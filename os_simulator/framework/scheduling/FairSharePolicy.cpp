@@ -0,0 +1,259 @@
+#include "FairSharePolicy.h"
+#include <pthread.h>
+#include <string.h>
+#include "threading/SimulatorContext.h"
+
+using namespace Threading;
+
+// The weight of DEFAULT_PRI; every priority step above it is worth 25% more
+// CPU time, and every step below it 20% less.
+static const long long NICE_0_WEIGHT = 1024;
+static const long long PRIORITY_WEIGHTS[MAX_PRI - MIN_PRI + 1] = {
+    419, 524, 655, 819, 1024, 1280, 1600, 2000, 2500, 3125};
+
+const FairShareConfig FairSharePolicy::DEFAULT_CONFIG = {1, true, 1};
+
+static long long weightOf(Thread* thread) {
+    int priority = thread->priority;
+    if (priority < MIN_PRI)
+        priority = MIN_PRI;
+    if (priority > MAX_PRI)
+        priority = MAX_PRI;
+    return PRIORITY_WEIGHTS[priority - MIN_PRI];
+}
+
+bool FairSharePolicy::EntityOrder::operator()(const Entity* first,
+                                               const Entity* second) const {
+    if (first->vruntime != second->vruntime)
+        return first->vruntime < second->vruntime;
+    return first->sequence < second->sequence;
+}
+
+FairSharePolicy::FairSharePolicy() {
+    simulator = Simulator::current();
+    config = simulator->fairShareConfig;
+    if (config.minGranularity < 1)
+        config.minGranularity = 1;
+    memset(&stats, 0, sizeof(stats));
+    stats.fairness = 1;
+    current = NULL;
+    currentRun = 0;
+    preemptingWakeup = false;
+    minVruntime = 0;
+    nextSequence = 0;
+    lastTick = 0;
+    shareSum = 0;
+    shareSquares = 0;
+    sharers = 0;
+    publishStats();
+}
+
+FairSharePolicy::~FairSharePolicy() {
+    for (map<Thread*, Entity*>::iterator iter = entities.begin();
+         iter != entities.end(); iter++) {
+        delete iter->second;
+    }
+}
+
+void FairSharePolicy::enqueue(Thread* thread) {
+    Entity* entity = new Entity();
+    entity->thread = thread;
+    entity->vruntime = minVruntime;
+    entity->sequence = nextSequence++;
+    entity->share = 0;
+    entity->readySince = lastTick + 1;
+    entity->wakeTick = BLOCK_UNTIL_WOKEN;
+    entity->queued = true;
+    entities[thread] = entity;
+    timeline.insert(entity);
+}
+
+void FairSharePolicy::dequeue(Thread* thread) {
+    map<Thread*, Entity*>::iterator found = entities.find(thread);
+    if (found == entities.end())
+        return;
+    Entity* entity = found->second;
+    if (entity->queued)
+        timeline.erase(entity);
+    if (entity->wakeTick != BLOCK_UNTIL_WOKEN) {
+        pair<multimap<int, Entity*>::iterator, multimap<int, Entity*>::iterator>
+            range = sleepers.equal_range(entity->wakeTick);
+        for (multimap<int, Entity*>::iterator iter = range.first;
+             iter != range.second; iter++) {
+            if (iter->second == entity) {
+                sleepers.erase(iter);
+                break;
+            }
+        }
+    }
+    if (current == entity)
+        current = NULL;
+    if (entity->share > 0) {
+        // The index only covers threads still competing for the CPU.
+        sharers--;
+        shareSum -= entity->share;
+        shareSquares -= entity->share * entity->share;
+        if (sharers > 0 && shareSquares > 0) {
+            stats.fairness = shareSum * shareSum / (sharers * shareSquares);
+            publishStats();
+        }
+    }
+    entities.erase(found);
+    delete entity;
+}
+
+Thread* FairSharePolicy::pick(int currentTick) {
+    if (timeline.empty()) {
+        current = NULL;
+        return NULL;
+    }
+    Entity* next = *timeline.begin();
+    if (current != NULL && currentRun < config.minGranularity &&
+        next != current) {
+        if (preemptingWakeup) {
+            stats.wakeupPreemptions++;
+        } else {
+            next = current;
+        }
+    }
+    preemptingWakeup = false;
+    if (next == current) {
+        currentRun++;
+    } else {
+        current = next;
+        currentRun = 1;
+    }
+
+    int latency = currentTick - next->readySince;
+    if (latency < 0)
+        latency = 0;
+    stats.picks++;
+    stats.totalLatency += latency;
+    if (latency > stats.maxLatency)
+        stats.maxLatency = latency;
+    charge(next, currentTick);
+    publishStats();
+    return next->thread;
+}
+
+// The thread gives up whatever is left of its minimum granularity.
+void FairSharePolicy::yield(Thread* thread) {
+    if (current != NULL && current->thread == thread)
+        current = NULL;
+}
+
+void FairSharePolicy::block(Thread* thread, int wakeTick) {
+    map<Thread*, Entity*>::iterator found = entities.find(thread);
+    if (found == entities.end())
+        return;
+    Entity* entity = found->second;
+    if (entity->queued) {
+        timeline.erase(entity);
+        entity->queued = false;
+    }
+    if (current == entity)
+        current = NULL;
+    entity->wakeTick = wakeTick;
+    if (wakeTick != BLOCK_UNTIL_WOKEN)
+        sleepers.insert(make_pair(wakeTick, entity));
+}
+
+void FairSharePolicy::wake(Thread* thread) {
+    map<Thread*, Entity*>::iterator found = entities.find(thread);
+    if (found == entities.end() || found->second->queued)
+        return;
+    Entity* entity = found->second;
+    if (entity->wakeTick != BLOCK_UNTIL_WOKEN) {
+        pair<multimap<int, Entity*>::iterator, multimap<int, Entity*>::iterator>
+            range = sleepers.equal_range(entity->wakeTick);
+        for (multimap<int, Entity*>::iterator iter = range.first;
+             iter != range.second; iter++) {
+            if (iter->second == entity) {
+                sleepers.erase(iter);
+                break;
+            }
+        }
+    }
+    wakeUp(entity, lastTick + 1);
+}
+
+// Weights are looked up every time a thread is charged, so a new priority
+// takes effect from the next tick without touching the tree.
+void FairSharePolicy::priorityChanged(Thread*, int) {}
+
+void FairSharePolicy::tick(int currentTick) {
+    lastTick = currentTick;
+    while (!sleepers.empty() && sleepers.begin()->first <= currentTick) {
+        Entity* entity = sleepers.begin()->second;
+        sleepers.erase(sleepers.begin());
+        wakeUp(entity, currentTick);
+    }
+}
+
+// A thread that slept keeps its virtual runtime but is not allowed to fall
+// more than one minimum granularity behind the ready threads, otherwise it
+// would monopolize the CPU until it caught up.
+void FairSharePolicy::wakeUp(Entity* entity, int readyTick) {
+    long long floor = minVruntime - config.minGranularity * NICE_0_WEIGHT;
+    if (entity->vruntime < floor)
+        entity->vruntime = floor;
+    entity->wakeTick = BLOCK_UNTIL_WOKEN;
+    entity->readySince = readyTick;
+    entity->queued = true;
+    timeline.insert(entity);
+    if (config.wakeupPreemption && current != NULL &&
+        entity->vruntime + config.wakeupGranularity * NICE_0_WEIGHT <
+            current->vruntime) {
+        preemptingWakeup = true;
+    }
+}
+
+void FairSharePolicy::charge(Entity* entity, int currentTick) {
+    long long delta = NICE_0_WEIGHT * NICE_0_WEIGHT / weightOf(entity->thread);
+    timeline.erase(entity);
+    entity->vruntime += delta;
+    entity->readySince = currentTick + 1;
+    timeline.insert(entity);
+    if (minVruntime < (*timeline.begin())->vruntime)
+        minVruntime = (*timeline.begin())->vruntime;
+
+    // Jain's index over weighted CPU time, kept as running sums so it costs
+    // O(1) per tick.
+    double share = (double)delta / NICE_0_WEIGHT;
+    if (entity->share == 0)
+        sharers++;
+    shareSum += share;
+    shareSquares += (entity->share + share) * (entity->share + share) -
+                    entity->share * entity->share;
+    entity->share += share;
+    stats.fairness = shareSum * shareSum / (sharers * shareSquares);
+    stats.vruntimeSpread =
+        (double)((*timeline.rbegin())->vruntime -
+                 (*timeline.begin())->vruntime) /
+        NICE_0_WEIGHT;
+}
+
+void FairSharePolicy::publishStats() {
+    pthread_mutex_lock(&simulator->policyStatsMutex);
+    simulator->fairShareStats = stats;
+    pthread_mutex_unlock(&simulator->policyStatsMutex);
+}
+
+void FairSharePolicy::configure(const FairShareConfig* config) {
+    Simulator::current()->fairShareConfig = *config;
+}
+
+void FairSharePolicy::copyStats(FairShareStats* out) {
+    Simulator* simulator = Simulator::current();
+    pthread_mutex_lock(&simulator->policyStatsMutex);
+    *out = simulator->fairShareStats;
+    pthread_mutex_unlock(&simulator->policyStatsMutex);
+}
+
+void setFairShareConfig(const FairShareConfig* config) {
+    FairSharePolicy::configure(config);
+}
+
+void getFairShareStats(FairShareStats* stats) {
+    FairSharePolicy::copyStats(stats);
+}
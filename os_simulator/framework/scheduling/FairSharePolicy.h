@@ -0,0 +1,77 @@
+#ifndef OS_THREADING_FAIRSHAREPOLICY_H
+#define OS_THREADING_FAIRSHAREPOLICY_H
+
+#include <map>
+#include <set>
+#include "Scheduler.h"
+#include "SchedulerPolicy.h"
+#include "Simulator.h"
+
+using namespace std;
+
+namespace Threading {
+
+/**
+ * The "cfs" policy. Every tick a thread runs adds to its virtual runtime in
+ * inverse proportion to the weight of its priority, and the ready thread with
+ * the least virtual runtime runs next, so low priorities get a smaller share
+ * of the CPU instead of none. Ready threads are kept in a balanced tree
+ * ordered by virtual runtime, which makes pick, charge and wake O(log n).
+ */
+class FairSharePolicy : public SchedulerPolicy {
+   public:
+    FairSharePolicy();
+    ~FairSharePolicy();
+    void enqueue(Thread* thread);
+    void dequeue(Thread* thread);
+    Thread* pick(int currentTick);
+    void yield(Thread* thread);
+    void block(Thread* thread, int wakeTick);
+    void wake(Thread* thread);
+    void priorityChanged(Thread* thread, int oldPriority);
+    void tick(int currentTick);
+    static void configure(const FairShareConfig* config);
+    static void copyStats(FairShareStats* out);
+    static const FairShareConfig DEFAULT_CONFIG;
+
+   private:
+    /**
+     * Per thread state. Virtual runtime is kept in units of 1/NICE_0_WEIGHT
+     * of a tick so charging stays in integers.
+     */
+    typedef struct Entity {
+        Thread* thread;
+        long long vruntime;
+        long sequence;
+        double share;
+        int readySince;
+        int wakeTick;
+        bool queued;
+    } Entity;
+
+    struct EntityOrder {
+        bool operator()(const Entity* first, const Entity* second) const;
+    };
+
+    Simulator* simulator;
+    FairShareConfig config;
+    FairShareStats stats;
+    map<Thread*, Entity*> entities;
+    set<Entity*, EntityOrder> timeline;
+    multimap<int, Entity*> sleepers;
+    Entity* current;
+    int currentRun;
+    bool preemptingWakeup;
+    long long minVruntime;
+    long nextSequence;
+    int lastTick;
+    double shareSum;
+    double shareSquares;
+    long sharers;
+    void wakeUp(Entity* entity, int readyTick);
+    void charge(Entity* entity, int currentTick);
+    void publishStats();
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_FAIRSHAREPOLICY_H
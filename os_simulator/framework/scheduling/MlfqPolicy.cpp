@@ -0,0 +1,242 @@
+#include "MlfqPolicy.h"
+#include <pthread.h>
+#include <string.h>
+#include "threading/SimulatorContext.h"
+
+using namespace Threading;
+
+const MlfqConfig MlfqPolicy::DEFAULT_CONFIG = {3, {1, 2, 4}, 50};
+
+MlfqPolicy::MlfqPolicy() {
+    simulator = Simulator::current();
+    config = simulator->mlfqConfig;
+    if (config.levels < 1)
+        config.levels = 1;
+    if (config.levels > MLFQ_MAX_LEVELS)
+        config.levels = MLFQ_MAX_LEVELS;
+    for (int x = 0; x < config.levels; x++) {
+        if (config.quantum[x] < 1)
+            config.quantum[x] = 1;
+    }
+    memset(&stats, 0, sizeof(stats));
+    current = NULL;
+    lastAging = 0;
+    publishStats();
+}
+
+MlfqPolicy::~MlfqPolicy() {
+    for (map<Thread*, Entity*>::iterator iter = entities.begin();
+         iter != entities.end(); iter++) {
+        delete iter->second;
+    }
+}
+
+void MlfqPolicy::enqueue(Thread* thread) {
+    Entity* entity = new Entity();
+    entity->thread = thread;
+    entity->level = 0;
+    entity->ticksUsed = 0;
+    entity->wakeTick = BLOCK_UNTIL_WOKEN;
+    entity->queued = false;
+    entities[thread] = entity;
+    push(entity);
+}
+
+void MlfqPolicy::dequeue(Thread* thread) {
+    map<Thread*, Entity*>::iterator found = entities.find(thread);
+    if (found == entities.end())
+        return;
+    Entity* entity = found->second;
+    if (current == entity)
+        current = NULL;
+    removeQueued(entity);
+    removeSleeping(entity);
+    entities.erase(found);
+    delete entity;
+}
+
+// The running thread is kept out of the queues. Reaching pick again with it
+// still current means its last tick ended in a preemption.
+Thread* MlfqPolicy::pick(int) {
+    if (current != NULL) {
+        Entity* entity = current;
+        current = NULL;
+        if (entity->ticksUsed >= config.quantum[entity->level]) {
+            if (entity->level < config.levels - 1) {
+                entity->level++;
+                stats.demotions++;
+            }
+            entity->ticksUsed = 0;
+            push(entity);
+        } else {
+            bool higherReady = false;
+            for (int x = 0; x < entity->level && !higherReady; x++) {
+                higherReady = !levels[x].empty();
+            }
+            if (higherReady) {
+                // Preempted by a higher level; it resumes its quantum first
+                // when its level runs again.
+                pushFront(entity);
+            } else {
+                current = entity;
+            }
+        }
+    }
+    if (current == NULL) {
+        for (int x = 0; x < config.levels && current == NULL; x++) {
+            if (!levels[x].empty()) {
+                current = levels[x].front();
+                levels[x].pop_front();
+                current->queued = false;
+            }
+        }
+    }
+    if (current == NULL)
+        return NULL;
+    current->ticksUsed++;
+    stats.levelPicks[current->level]++;
+    publishStats();
+    return current->thread;
+}
+
+// Only a thread that gives up the CPU before its quantum is over is moved up.
+// One that used it all stays on its level with the ticks it used, so yielding
+// at the end of every quantum does not keep a busy thread from sinking.
+void MlfqPolicy::yield(Thread* thread) {
+    if (current == NULL || current->thread != thread)
+        return;
+    Entity* entity = current;
+    current = NULL;
+    if (entity->ticksUsed < config.quantum[entity->level])
+        promote(entity);
+    push(entity);
+}
+
+void MlfqPolicy::block(Thread* thread, int wakeTick) {
+    map<Thread*, Entity*>::iterator found = entities.find(thread);
+    if (found == entities.end())
+        return;
+    Entity* entity = found->second;
+    if (current == entity)
+        current = NULL;
+    removeQueued(entity);
+    entity->wakeTick = wakeTick;
+    if (wakeTick != BLOCK_UNTIL_WOKEN)
+        entity->sleeping = sleepers.insert(make_pair(wakeTick, entity));
+}
+
+void MlfqPolicy::wake(Thread* thread) {
+    map<Thread*, Entity*>::iterator found = entities.find(thread);
+    if (found == entities.end())
+        return;
+    Entity* entity = found->second;
+    if (entity->queued || entity == current)
+        return;
+    removeSleeping(entity);
+    promote(entity);
+    push(entity);
+}
+
+// Levels take the place of priorities.
+void MlfqPolicy::priorityChanged(Thread*, int) {}
+
+void MlfqPolicy::tick(int currentTick) {
+    while (!sleepers.empty() && sleepers.begin()->first <= currentTick) {
+        Entity* entity = sleepers.begin()->second;
+        sleepers.erase(sleepers.begin());
+        entity->wakeTick = BLOCK_UNTIL_WOKEN;
+        promote(entity);
+        push(entity);
+    }
+    if (config.agingInterval > 0 &&
+        currentTick - lastAging >= config.agingInterval) {
+        lastAging = currentTick;
+        age();
+    }
+}
+
+void MlfqPolicy::push(Entity* entity) {
+    list<Entity*>& level = levels[entity->level];
+    entity->position = level.insert(level.end(), entity);
+    entity->queued = true;
+}
+
+void MlfqPolicy::pushFront(Entity* entity) {
+    list<Entity*>& level = levels[entity->level];
+    entity->position = level.insert(level.begin(), entity);
+    entity->queued = true;
+}
+
+void MlfqPolicy::promote(Entity* entity) {
+    if (entity->level > 0) {
+        entity->level--;
+        stats.promotions++;
+    }
+    entity->ticksUsed = 0;
+}
+
+void MlfqPolicy::removeQueued(Entity* entity) {
+    if (!entity->queued)
+        return;
+    levels[entity->level].erase(entity->position);
+    entity->queued = false;
+}
+
+void MlfqPolicy::removeSleeping(Entity* entity) {
+    if (entity->wakeTick == BLOCK_UNTIL_WOKEN)
+        return;
+    sleepers.erase(entity->sleeping);
+    entity->wakeTick = BLOCK_UNTIL_WOKEN;
+}
+
+// Moves every thread to level 0. Ready threads keep the order of their levels
+// so the ones that sank furthest still run last.
+void MlfqPolicy::age() {
+    for (int x = 1; x < config.levels; x++) {
+        for (list<Entity*>::iterator iter = levels[x].begin();
+             iter != levels[x].end(); iter++) {
+            (*iter)->level = 0;
+            (*iter)->ticksUsed = 0;
+        }
+        // Splicing keeps every entity's position valid.
+        levels[0].splice(levels[0].end(), levels[x]);
+    }
+    if (current != NULL) {
+        current->level = 0;
+        current->ticksUsed = 0;
+    }
+    for (map<Thread*, Entity*>::iterator iter = entities.begin();
+         iter != entities.end(); iter++) {
+        if (!iter->second->queued && iter->second != current) {
+            iter->second->level = 0;
+            iter->second->ticksUsed = 0;
+        }
+    }
+    stats.agingPasses++;
+    publishStats();
+}
+
+void MlfqPolicy::publishStats() {
+    pthread_mutex_lock(&simulator->policyStatsMutex);
+    simulator->mlfqStats = stats;
+    pthread_mutex_unlock(&simulator->policyStatsMutex);
+}
+
+void MlfqPolicy::configure(const MlfqConfig* config) {
+    Simulator::current()->mlfqConfig = *config;
+}
+
+void MlfqPolicy::copyStats(MlfqStats* out) {
+    Simulator* simulator = Simulator::current();
+    pthread_mutex_lock(&simulator->policyStatsMutex);
+    *out = simulator->mlfqStats;
+    pthread_mutex_unlock(&simulator->policyStatsMutex);
+}
+
+void setMlfqConfig(const MlfqConfig* config) {
+    MlfqPolicy::configure(config);
+}
+
+void getMlfqStats(MlfqStats* stats) {
+    MlfqPolicy::copyStats(stats);
+}
@@ -0,0 +1,66 @@
+#ifndef OS_THREADING_MLFQPOLICY_H
+#define OS_THREADING_MLFQPOLICY_H
+
+#include <list>
+#include <map>
+#include "Scheduler.h"
+#include "SchedulerPolicy.h"
+#include "Simulator.h"
+
+using namespace std;
+
+namespace Threading {
+
+/**
+ * The "mlfq" policy, a multi-level feedback queue. How a thread used its last
+ * slice decides its level: CPU-bound threads sink, threads that yield or sleep
+ * rise, and a periodic aging pass lifts everyone back to the top.
+ */
+class MlfqPolicy : public SchedulerPolicy {
+   public:
+    MlfqPolicy();
+    ~MlfqPolicy();
+    void enqueue(Thread* thread);
+    void dequeue(Thread* thread);
+    Thread* pick(int currentTick);
+    void yield(Thread* thread);
+    void block(Thread* thread, int wakeTick);
+    void wake(Thread* thread);
+    void priorityChanged(Thread* thread, int oldPriority);
+    void tick(int currentTick);
+    static void configure(const MlfqConfig* config);
+    static void copyStats(MlfqStats* out);
+    static const MlfqConfig DEFAULT_CONFIG;
+
+   private:
+    typedef struct Entity {
+        Thread* thread;
+        int level;
+        int ticksUsed;
+        int wakeTick;
+        bool queued;
+        // Where the entity sits in its level while queued, and in sleepers
+        // while it has a wake tick, so neither has to be searched for.
+        list<struct Entity*>::iterator position;
+        multimap<int, struct Entity*>::iterator sleeping;
+    } Entity;
+
+    Simulator* simulator;
+    MlfqConfig config;
+    MlfqStats stats;
+    map<Thread*, Entity*> entities;
+    list<Entity*> levels[MLFQ_MAX_LEVELS];
+    multimap<int, Entity*> sleepers;
+    Entity* current;
+    int lastAging;
+    void push(Entity* entity);
+    void pushFront(Entity* entity);
+    void promote(Entity* entity);
+    void removeQueued(Entity* entity);
+    void removeSleeping(Entity* entity);
+    void age();
+    void publishStats();
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_MLFQPOLICY_H
@@ -0,0 +1,135 @@
+#include "PriorityRoundRobinPolicy.h"
+#include "threading/SimulatorContext.h"
+
+using namespace Threading;
+
+const TimeSliceConfig PriorityRoundRobinPolicy::DEFAULT_CONFIG = {
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}};
+
+PriorityRoundRobinPolicy::PriorityRoundRobinPolicy() {
+    config = Simulator::current()->timeSliceConfig;
+    for (int x = 0; x < MAX_PRI - MIN_PRI + 1; x++) {
+        if (config.sliceTicks[x] < 1)
+            config.sliceTicks[x] = 1;
+    }
+    current = NULL;
+    currentRun = 0;
+    repick = false;
+}
+
+// A thread that became ready only matters to a running slice if it outranks
+// the thread running it.
+void PriorityRoundRobinPolicy::arrived(Thread* thread) {
+    if (current != NULL && thread->priority > current->priority)
+        repick = true;
+}
+
+void PriorityRoundRobinPolicy::enqueue(Thread* thread) {
+    ready.insert(thread);
+    threadReady(thread);
+    arrived(thread);
+}
+
+// The thread has ended. Blocking it for good takes it out of the ready list
+// before its record can be freed and handed out again.
+void PriorityRoundRobinPolicy::dequeue(Thread* thread) {
+    ready.erase(thread);
+    if (current == thread)
+        current = NULL;
+    threadBlocked(thread, NO_WAKE_TICK);
+}
+
+Thread* PriorityRoundRobinPolicy::pick(int currentTick) {
+    // nextThreadToRun wakes sleepers itself, so one that is due may be about
+    // to outrank the running thread.
+    while (!sleepers.empty() && sleepers.top().first <= currentTick) {
+        Thread* woken = sleepers.top().second;
+        sleepers.pop();
+        ready.insert(woken);
+        arrived(woken);
+    }
+    // The slice is not over, so only a higher priority may take the CPU.
+    // Asking nextThreadToRun would move the running thread behind its peers.
+    if (current != NULL && currentRun < sliceTicks(current) &&
+        !(repick && outranked(current))) {
+        repick = false;
+        currentRun++;
+        return current;
+    }
+    repick = false;
+    Thread* next = nextThreadToRun(currentTick);
+    if (next != NULL && next == current) {
+        currentRun++;
+    } else {
+        current = next;
+        currentRun = 1;
+    }
+    return next;
+}
+
+// nextThreadToRun already moved the thread behind its peers when it picked it;
+// all that is left is to end its slice.
+void PriorityRoundRobinPolicy::yield(Thread* thread) {
+    if (current == thread)
+        current = NULL;
+}
+
+void PriorityRoundRobinPolicy::block(Thread* thread, int wakeTick) {
+    if (current == thread)
+        current = NULL;
+    ready.erase(thread);
+    if (wakeTick != NO_WAKE_TICK)
+        sleepers.push(make_pair(wakeTick, thread));
+    threadBlocked(thread, wakeTick);
+}
+
+void PriorityRoundRobinPolicy::wake(Thread* thread) {
+    ready.insert(thread);
+    threadReady(thread);
+    arrived(thread);
+}
+
+// A running thread that drops may now be outranked by a thread already ready.
+void PriorityRoundRobinPolicy::priorityChanged(Thread* thread,
+                                               int oldPriority) {
+    threadPriorityChanged(thread, oldPriority);
+    if (thread == current)
+        repick = repick || thread->priority < oldPriority;
+    else
+        arrived(thread);
+}
+
+// nextThreadToRun wakes sleepers itself.
+void PriorityRoundRobinPolicy::tick(int) {}
+
+void PriorityRoundRobinPolicy::configure(const TimeSliceConfig* config) {
+    Simulator::current()->timeSliceConfig = *config;
+}
+
+bool PriorityRoundRobinPolicy::usesStudentCallbacks() {
+    return true;
+}
+
+// Reads the priorities as they are now, since the student callbacks may have
+// donated to a thread without the policy being told.
+bool PriorityRoundRobinPolicy::outranked(Thread* thread) {
+    for (set<Thread*>::iterator other = ready.begin(); other != ready.end();
+         other++) {
+        if ((*other)->priority > thread->priority)
+            return true;
+    }
+    return false;
+}
+
+int PriorityRoundRobinPolicy::sliceTicks(Thread* thread) {
+    int priority = thread->priority;
+    if (priority < MIN_PRI)
+        priority = MIN_PRI;
+    if (priority > MAX_PRI)
+        priority = MAX_PRI;
+    return config.sliceTicks[priority - MIN_PRI];
+}
+
+void setTimeSliceConfig(const TimeSliceConfig* config) {
+    PriorityRoundRobinPolicy::configure(config);
+}
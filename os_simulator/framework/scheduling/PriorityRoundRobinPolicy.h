@@ -0,0 +1,60 @@
+#ifndef OS_THREADING_PRIORITYROUNDROBINPOLICY_H
+#define OS_THREADING_PRIORITYROUNDROBINPOLICY_H
+
+#include <functional>
+#include <queue>
+#include <set>
+#include <utility>
+#include <vector>
+#include "Scheduler.h"
+#include "SchedulerPolicy.h"
+
+using namespace std;
+
+namespace Threading {
+
+/**
+ * The default policy. Scheduling is left to the functions students implement
+ * in Thread.student.h: nextThreadToRun picks and wakes sleepers, and the
+ * thread callbacks keep the ready list up to date. The policy only stretches
+ * a pick into a time slice of several ticks when TimeSliceConfig asks for it.
+ *
+ * During a slice the running thread keeps the CPU without nextThreadToRun
+ * being asked again, unless a thread of higher priority may have become
+ * ready: one was created, woken or raised above it, or a sleeper is due. The
+ * policy keeps its own record of which threads are ready, so it can tell
+ * whether one of them outranks the running thread without the side effects of
+ * picking.
+ */
+class PriorityRoundRobinPolicy : public SchedulerPolicy {
+   public:
+    PriorityRoundRobinPolicy();
+    void enqueue(Thread* thread);
+    void dequeue(Thread* thread);
+    Thread* pick(int currentTick);
+    void yield(Thread* thread);
+    void block(Thread* thread, int wakeTick);
+    void wake(Thread* thread);
+    void priorityChanged(Thread* thread, int oldPriority);
+    void tick(int currentTick);
+    bool usesStudentCallbacks();
+    static void configure(const TimeSliceConfig* config);
+    static const TimeSliceConfig DEFAULT_CONFIG;
+
+   private:
+    TimeSliceConfig config;
+    Thread* current;
+    int currentRun;
+    bool repick;
+    set<Thread*> ready;
+    priority_queue<pair<int, Thread*>,
+                   vector<pair<int, Thread*>>,
+                   greater<pair<int, Thread*>>>
+        sleepers;
+    int sliceTicks(Thread* thread);
+    void arrived(Thread* thread);
+    bool outranked(Thread* thread);
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_PRIORITYROUNDROBINPOLICY_H
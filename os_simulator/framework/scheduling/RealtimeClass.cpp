@@ -0,0 +1,243 @@
+#include "RealtimeClass.h"
+#include <pthread.h>
+#include <string.h>
+#include "threading/SimulatorContext.h"
+
+using namespace Threading;
+
+// Admission works on doubles; this keeps sets like 1/3 + 1/3 + 1/3 in.
+static const double UTILIZATION_SLACK = 1e-9;
+
+bool RealtimeClass::DeadlineOrder::operator()(const Entity* first,
+                                              const Entity* second) const {
+    if (first->deadline != second->deadline)
+        return first->deadline < second->deadline;
+    return first->sequence < second->sequence;
+}
+
+RealtimeClass::RealtimeClass() {
+    memset(&stats, 0, sizeof(stats));
+    nextSequence = 0;
+    lastTick = 0;
+    simulator = Simulator::current();
+    pthread_mutex_lock(&simulator->policyStatsMutex);
+    simulator->realtimeThreadStats.clear();
+    pthread_mutex_unlock(&simulator->policyStatsMutex);
+    publishStats(NULL);
+}
+
+RealtimeClass::~RealtimeClass() {
+    for (map<Thread*, Entity*>::iterator iter = entities.begin();
+         iter != entities.end(); iter++) {
+        delete iter->second;
+    }
+}
+
+bool RealtimeClass::admit(Thread* thread, const RealtimeParams* params) {
+    RealtimeParams checked = *params;
+    if (checked.deadline == 0)
+        checked.deadline = checked.period;
+    bool valid = checked.period > 0 && checked.budget > 0 &&
+                 checked.budget <= checked.deadline &&
+                 checked.deadline <= checked.period;
+    double density = valid ? (double)checked.budget / checked.deadline : 0;
+    if (!valid || stats.utilization + density > 1 + UTILIZATION_SLACK) {
+        stats.rejected++;
+        publishStats(NULL);
+        return false;
+    }
+    Entity* entity = new Entity();
+    memset(entity, 0, sizeof(Entity));
+    entity->thread = thread;
+    entity->params = checked;
+    entity->density = density;
+    entity->sequence = nextSequence++;
+    entity->wakeTick = BLOCK_UNTIL_WOKEN;
+    entities[thread] = entity;
+    stats.admitted++;
+    stats.utilization += density;
+    enqueue(thread);
+    return true;
+}
+
+bool RealtimeClass::contains(Thread* thread) {
+    return entities.count(thread) == 1;
+}
+
+// The first job is released on the next tick.
+void RealtimeClass::enqueue(Thread* thread) {
+    Entity* entity = find(thread);
+    if (entity == NULL)
+        return;
+    entity->state = JOB_WAITING;
+    entity->nextRelease = lastTick + 1;
+    publishStats(entity);
+}
+
+int RealtimeClass::complete(Thread* thread) {
+    Entity* entity = find(thread);
+    if (entity == NULL)
+        return lastTick + 1;
+    if (entity->jobPending && lastTick >= entity->deadline) {
+        int lateness = lastTick - entity->deadline + 1;
+        if (lateness > entity->stats.maxLateness)
+            entity->stats.maxLateness = lateness;
+    }
+    entity->jobPending = false;
+    setState(entity, JOB_WAITING);
+    publishStats(entity);
+    return entity->nextRelease;
+}
+
+void RealtimeClass::dequeue(Thread* thread) {
+    Entity* entity = find(thread);
+    if (entity == NULL)
+        return;
+    setState(entity, JOB_WAITING);
+    stats.utilization -= entity->density;
+    publishStats(entity);
+    entities.erase(thread);
+    delete entity;
+}
+
+Thread* RealtimeClass::pick(int) {
+    if (ready.empty())
+        return NULL;
+    Entity* entity = *ready.begin();
+    entity->budgetLeft--;
+    if (entity->budgetLeft == 0)
+        setState(entity, JOB_EXHAUSTED);
+    return entity->thread;
+}
+
+// Yielding does not give up the budget; the thread stays ready.
+void RealtimeClass::yield(Thread*) {}
+
+void RealtimeClass::block(Thread* thread, int wakeTick) {
+    Entity* entity = find(thread);
+    if (entity == NULL)
+        return;
+    entity->wakeTick = wakeTick;
+    setState(entity, JOB_SLEEPING);
+}
+
+void RealtimeClass::wake(Thread* thread) {
+    Entity* entity = find(thread);
+    if (entity == NULL || entity->state != JOB_SLEEPING)
+        return;
+    entity->wakeTick = BLOCK_UNTIL_WOKEN;
+    setState(entity, entity->budgetLeft > 0 ? JOB_READY : JOB_THROTTLED);
+}
+
+// Deadlines are in ticks, priorities do not apply.
+void RealtimeClass::priorityChanged(Thread*, int) {}
+
+void RealtimeClass::tick(int currentTick) {
+    lastTick = currentTick;
+    for (map<Thread*, Entity*>::iterator iter = entities.begin();
+         iter != entities.end(); iter++) {
+        Entity* entity = iter->second;
+        bool changed = false;
+        if (entity->state == JOB_EXHAUSTED) {
+            // Ran out of budget without finishing the job.
+            setState(entity, JOB_THROTTLED);
+            entity->stats.throttles++;
+            stats.throttles++;
+            changed = true;
+        }
+        if (entity->state == JOB_SLEEPING &&
+            entity->wakeTick != BLOCK_UNTIL_WOKEN &&
+            entity->wakeTick <= currentTick) {
+            entity->wakeTick = BLOCK_UNTIL_WOKEN;
+            setState(entity,
+                     entity->budgetLeft > 0 ? JOB_READY : JOB_THROTTLED);
+        }
+        if (currentTick >= entity->nextRelease) {
+            release(entity);
+            changed = true;
+        }
+        if (entity->jobPending && !entity->missed &&
+            currentTick >= entity->deadline) {
+            entity->missed = true;
+            entity->stats.deadlineMisses++;
+            stats.deadlineMisses++;
+            changed = true;
+        }
+        if (changed)
+            publishStats(entity);
+    }
+}
+
+RealtimeClass::Entity* RealtimeClass::find(Thread* thread) {
+    map<Thread*, Entity*>::iterator found = entities.find(thread);
+    return found != entities.end() ? found->second : NULL;
+}
+
+// Keeps the ready tree in step with the state; the deadline of an entity must
+// not change while it is in the tree.
+void RealtimeClass::setState(Entity* entity, JobState state) {
+    if (entity->state == JOB_READY)
+        ready.erase(entity);
+    entity->state = state;
+    if (state == JOB_READY)
+        ready.insert(entity);
+}
+
+// A job that is still running when the next one is released carries on as the
+// new job; its miss was counted at its own deadline.
+void RealtimeClass::release(Entity* entity) {
+    JobState state = entity->state;
+    setState(entity, JOB_WAITING);
+    entity->deadline = entity->nextRelease + entity->params.deadline;
+    entity->nextRelease += entity->params.period;
+    entity->budgetLeft = entity->params.budget;
+    entity->jobPending = true;
+    entity->missed = false;
+    entity->stats.jobs++;
+    stats.jobs++;
+    setState(entity, state == JOB_SLEEPING ? JOB_SLEEPING : JOB_READY);
+}
+
+void RealtimeClass::publishStats(Entity* entity) {
+    pthread_mutex_lock(&simulator->policyStatsMutex);
+    simulator->realtimeStats = stats;
+    if (entity != NULL)
+        simulator->realtimeThreadStats[entity->thread] = entity->stats;
+    pthread_mutex_unlock(&simulator->policyStatsMutex);
+}
+
+void RealtimeClass::copyStats(RealtimeStats* out) {
+    Simulator* simulator = Simulator::current();
+    pthread_mutex_lock(&simulator->policyStatsMutex);
+    *out = simulator->realtimeStats;
+    pthread_mutex_unlock(&simulator->policyStatsMutex);
+}
+
+bool RealtimeClass::copyThreadStats(Thread* thread, RealtimeThreadStats* out) {
+    Simulator* simulator = Simulator::current();
+    pthread_mutex_lock(&simulator->policyStatsMutex);
+    map<Thread*, RealtimeThreadStats>::iterator found =
+        simulator->realtimeThreadStats.find(thread);
+    bool ret = found != simulator->realtimeThreadStats.end();
+    if (ret)
+        *out = found->second;
+    pthread_mutex_unlock(&simulator->policyStatsMutex);
+    return ret;
+}
+
+// The counters outlive the thread's run so they can be read after it, but not
+// its record, which the next thread allocated may be given.
+void RealtimeClass::forgetThreadStats(Thread* thread) {
+    Simulator* simulator = Simulator::current();
+    pthread_mutex_lock(&simulator->policyStatsMutex);
+    simulator->realtimeThreadStats.erase(thread);
+    pthread_mutex_unlock(&simulator->policyStatsMutex);
+}
+
+void getRealtimeStats(RealtimeStats* stats) {
+    RealtimeClass::copyStats(stats);
+}
+
+bool getRealtimeThreadStats(Thread* thread, RealtimeThreadStats* stats) {
+    return RealtimeClass::copyThreadStats(thread, stats);
+}
@@ -0,0 +1,81 @@
+#ifndef OS_THREADING_REALTIMECLASS_H
+#define OS_THREADING_REALTIMECLASS_H
+
+#include <map>
+#include <set>
+#include "Scheduler.h"
+#include "SchedulerPolicy.h"
+#include "Simulator.h"
+
+using namespace std;
+
+namespace Threading {
+
+/**
+ * Periodic real-time threads scheduled earliest deadline first. The
+ * ThreadManager asks this class before the scheduling policy on every tick,
+ * and only threads admitted through admit belong to it. Real-time threads are
+ * expected to be few, so releases and deadlines are checked by walking all of
+ * them every tick; picking uses a tree ordered by deadline.
+ */
+class RealtimeClass : public SchedulerPolicy {
+   public:
+    RealtimeClass();
+    ~RealtimeClass();
+    bool admit(Thread* thread, const RealtimeParams* params);
+    bool contains(Thread* thread);
+    int complete(Thread* thread);
+    void enqueue(Thread* thread);
+    void dequeue(Thread* thread);
+    Thread* pick(int currentTick);
+    void yield(Thread* thread);
+    void block(Thread* thread, int wakeTick);
+    void wake(Thread* thread);
+    void priorityChanged(Thread* thread, int oldPriority);
+    void tick(int currentTick);
+    static void copyStats(RealtimeStats* out);
+    static bool copyThreadStats(Thread* thread, RealtimeThreadStats* out);
+    static void forgetThreadStats(Thread* thread);
+
+   private:
+    typedef enum JobState {
+        JOB_WAITING,
+        JOB_READY,
+        JOB_EXHAUSTED,
+        JOB_THROTTLED,
+        JOB_SLEEPING
+    } JobState;
+
+    typedef struct Entity {
+        Thread* thread;
+        RealtimeParams params;
+        double density;
+        long sequence;
+        JobState state;
+        int nextRelease;
+        int deadline;
+        int budgetLeft;
+        bool jobPending;
+        bool missed;
+        int wakeTick;
+        RealtimeThreadStats stats;
+    } Entity;
+
+    struct DeadlineOrder {
+        bool operator()(const Entity* first, const Entity* second) const;
+    };
+
+    Simulator* simulator;
+    RealtimeStats stats;
+    map<Thread*, Entity*> entities;
+    set<Entity*, DeadlineOrder> ready;
+    long nextSequence;
+    int lastTick;
+    Entity* find(Thread* thread);
+    void setState(Entity* entity, JobState state);
+    void release(Entity* entity);
+    void publishStats(Entity* entity);
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_REALTIMECLASS_H
@@ -0,0 +1,42 @@
+#include "SchedulerPolicy.h"
+#include <string.h>
+#include "FairSharePolicy.h"
+#include "MlfqPolicy.h"
+#include "PriorityRoundRobinPolicy.h"
+
+using namespace Threading;
+
+typedef struct PolicyEntry {
+    const char* name;
+    SchedulerPolicy* (*create)();
+} PolicyEntry;
+
+static SchedulerPolicy* createPriorityRoundRobin() {
+    return new PriorityRoundRobinPolicy();
+}
+
+static SchedulerPolicy* createFairShare() {
+    return new FairSharePolicy();
+}
+
+static SchedulerPolicy* createMlfq() {
+    return new MlfqPolicy();
+}
+
+// The first entry is the default.
+static const PolicyEntry policies[] = {
+    {"priority-rr", createPriorityRoundRobin},
+    {"cfs", createFairShare},
+    {"mlfq", createMlfq},
+};
+
+SchedulerPolicy* SchedulerPolicy::create(const char* name) {
+    if (name == NULL)
+        return policies[0].create();
+    for (unsigned int x = 0; x < sizeof(policies) / sizeof(policies[0]);
+         x++) {
+        if (strcmp(name, policies[x].name) == 0)
+            return policies[x].create();
+    }
+    return NULL;
+}
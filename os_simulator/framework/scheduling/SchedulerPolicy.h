@@ -0,0 +1,89 @@
+#ifndef OS_THREADING_SCHEDULERPOLICY_H
+#define OS_THREADING_SCHEDULERPOLICY_H
+
+#include "Thread.h"
+
+namespace Threading {
+
+/**
+ * Wake tick passed to SchedulerPolicy::block for a thread that stays blocked
+ * until SchedulerPolicy::wake is called for it.
+ */
+const int BLOCK_UNTIL_WOKEN = NO_WAKE_TICK;
+
+/**
+ * Policy a simulator runs instead of one that uses the student callbacks when
+ * another simulator holds them.
+ */
+const char* const FALLBACK_POLICY = "cfs";
+
+/**
+ * Decides which thread runs on each tick. The ThreadManager owns one policy
+ * per run and calls every hook with its policy mutex held, so a policy needs
+ * no locking of its own. Hooks are only called for threads that were given to
+ * enqueue.
+ */
+class SchedulerPolicy {
+   public:
+    virtual ~SchedulerPolicy() {}
+
+    /**
+     * A thread was created and is ready to run.
+     */
+    virtual void enqueue(Thread* thread) = 0;
+
+    /**
+     * A thread terminated and must not be picked again.
+     */
+    virtual void dequeue(Thread* thread) = 0;
+
+    /**
+     * Chooses the thread to run during currentTick.
+     *
+     * @return The thread to run or NULL to leave the CPU idle.
+     */
+    virtual Thread* pick(int currentTick) = 0;
+
+    /**
+     * The running thread gave up the rest of its slice but is still ready.
+     */
+    virtual void yield(Thread* thread) = 0;
+
+    /**
+     * The running thread is not ready until wakeTick, or until wake is
+     * called if wakeTick is BLOCK_UNTIL_WOKEN.
+     */
+    virtual void block(Thread* thread, int wakeTick) = 0;
+
+    /**
+     * A thread blocked until woken is ready again.
+     */
+    virtual void wake(Thread* thread) = 0;
+
+    /**
+     * thread->priority has been changed from oldPriority.
+     */
+    virtual void priorityChanged(Thread* thread, int oldPriority) = 0;
+
+    /**
+     * Called at the start of every tick before pick.
+     */
+    virtual void tick(int currentTick) = 0;
+
+    /**
+     * Whether the policy schedules through the callbacks in Thread.student.h,
+     * which only one simulator at a time can use.
+     */
+    virtual bool usesStudentCallbacks() { return false; }
+
+    /**
+     * Builds the policy registered under name.
+     *
+     * @param name The policy name, NULL for the default policy.
+     * @return A new policy or NULL if no policy has that name.
+     */
+    static SchedulerPolicy* create(const char* name);
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_SCHEDULERPOLICY_H
@@ -2,16 +2,11 @@
 #include "List.h"
 
 #include <algorithm>
-
-ListManager* ListManager::singleton = NULL;
+#include "threading/SimulatorContext.h"
 
 ListManager::ListManager() : StructureManager() {}
 
-ListManager::~ListManager() {
-    if (singleton != NULL) {
-        delete singleton;
-    }
-}
+ListManager::~ListManager() {}
 
 const char* createNewList() {
     return ListManager::getInstance()->create();
@@ -90,10 +85,7 @@ void* ListManager::remove(const char* listIdentifier, int index) {
 }
 
 ListManager* ListManager::getInstance() {
-    if (singleton == NULL) {
-        singleton = new ListManager();
-    }
-    return singleton;
+    return Simulator::current()->lists;
 }
 
 void* ListManager::get(const char* listIdentifier, int index) {
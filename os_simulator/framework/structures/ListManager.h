@@ -7,9 +7,12 @@
 
 using namespace std;
 
+struct Simulator;
+
+// The lists of the simulator bound to the calling thread.
 class ListManager : public StructureManager<vector<void*>> {
    private:
-    static ListManager* singleton;
+    friend struct ::Simulator;
     ListManager();
     ~ListManager();
 
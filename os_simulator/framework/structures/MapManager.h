@@ -2,13 +2,17 @@
 #define FRAMEWORK_MAPMANAGER_H
 
 #include "StructureManager.h"
+#include "threading/SimulatorContext.h"
 
+// The maps with keys of type U of the simulator bound to the calling thread.
 template <class U>
 class MapManager : public StructureManager<map<U, void*>> {
    private:
-    static MapManager<U>* singleton;
+    // Its address tells the managers of different key types apart.
+    static const char type;
     MapManager();
     ~MapManager();
+    static Structures* build();
 
    public:
     static MapManager<U>* getInstance();
@@ -53,18 +57,25 @@ template <class U>
 MapManager<U>::MapManager() : StructureManager<map<U, void*>>() {}
 
 template <class U>
-MapManager<U>::~MapManager() {
-    if (singleton != NULL) {
-        delete singleton;
-    }
+MapManager<U>::~MapManager() {}
+
+template <class U>
+Structures* MapManager<U>::build() {
+    return new MapManager<U>();
 }
 
+// The manager last found by the calling thread is kept, as it is looked up on
+// every call. Serials are never reused, unlike the addresses of simulators.
 template <class U>
 MapManager<U>* MapManager<U>::getInstance() {
-    if (singleton == NULL) {
-        singleton = new MapManager<U>();
+    static thread_local long foundSerial = 0;
+    static thread_local MapManager<U>* found = NULL;
+    Simulator* simulator = Simulator::current();
+    if (simulator->serial != foundSerial) {
+        found = (MapManager<U>*)simulator->mapManager(&type, build);
+        foundSerial = simulator->serial;
     }
-    return singleton;
+    return found;
 }
 
 template <class U>
@@ -92,5 +103,5 @@ void MapManager<U>::execOnMap(const char* mapIdentifier,
 }
 
 template <class U>
-MapManager<U>* MapManager<U>::singleton = NULL;
+const char MapManager<U>::type = 0;
 #endif  // FRAMEWORK_MAPMANAGER_H
@@ -1,18 +1,20 @@
 #ifndef FRAMEWORK_STRUCTUREMANAGER_H
 #define FRAMEWORK_STRUCTUREMANAGER_H
 
-// TODO: Factor this out into a separate header instead of duplicating it.
-#ifndef UUID_LENGTH
-#define UUID_LENGTH 37
-#endif
-
-#include <uuid/uuid.h>
+#include <pthread.h>
 #include <map>
+#include "Uuid.h"
 
 using namespace std;
 
+// Lets a simulator own managers of any kind of structure.
+class Structures {
+   public:
+    virtual ~Structures() {}
+};
+
 template <class T>
-class StructureManager {
+class StructureManager : public Structures {
    protected:
     map<const char*, pair<T, pthread_mutex_t>> structures;
     pthread_mutex_t mapMutex;
@@ -35,15 +37,13 @@ StructureManager<T>::~StructureManager() {
     pthread_mutex_destroy(&mapMutex);
     for (auto iter = structures.begin(); iter != structures.end(); iter++) {
         pthread_mutex_destroy(&(iter->second.second));
+        delete[] iter->first;
     }
 }
 
 template <class T>
 char* StructureManager<T>::create() {
-    uuid_t uuid;
-    uuid_generate(uuid);
-    char* idPtr = new char[UUID_LENGTH]();
-    uuid_unparse(uuid, idPtr);
+    char* idPtr = createUuid();
 
     pthread_mutex_lock(&mapMutex);
     pthread_mutex_t innerMutex;
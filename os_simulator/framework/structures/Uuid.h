@@ -0,0 +1,23 @@
+#ifndef FRAMEWORK_UUID_H
+#define FRAMEWORK_UUID_H
+
+#include <uuid/uuid.h>
+
+// 36 bytes and a null character
+#define UUID_LENGTH 37
+
+// Writes a new random identifier into id, which holds UUID_LENGTH bytes.
+inline void writeUuid(char* id) {
+    uuid_t uuid;
+    uuid_generate(uuid);
+    uuid_unparse(uuid, id);
+}
+
+// Returns a new random identifier. The caller frees it with delete[].
+inline char* createUuid() {
+    char* id = new char[UUID_LENGTH]();
+    writeUuid(id);
+    return id;
+}
+
+#endif  // FRAMEWORK_UUID_H
@@ -0,0 +1,57 @@
+#include "EventQueue.h"
+
+using namespace Threading;
+
+static const size_t EVENT_QUEUE_MASK = EVENT_QUEUE_CAPACITY - 1;
+
+// A cell whose sequence equals a push position is free for that push; once
+// the event is in it the sequence moves one past, which is what the pop at
+// that position waits for.
+EventQueue::EventQueue() {
+    cells = new Cell[EVENT_QUEUE_CAPACITY];
+    for (size_t x = 0; x < (size_t)EVENT_QUEUE_CAPACITY; x++) {
+        cells[x].sequence.store(x, memory_order_relaxed);
+    }
+    pushPosition.store(0, memory_order_relaxed);
+    popPosition = 0;
+}
+
+EventQueue::~EventQueue() {
+    delete[] cells;
+}
+
+// Returns false instead of waiting when the queue is full.
+bool EventQueue::push(const Event& event) {
+    size_t position = pushPosition.load(memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & EVENT_QUEUE_MASK];
+        size_t sequence = cell->sequence.load(memory_order_acquire);
+        long difference = (long)sequence - (long)position;
+        if (difference == 0) {
+            if (pushPosition.compare_exchange_weak(position, position + 1,
+                                                   memory_order_relaxed))
+                break;
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = pushPosition.load(memory_order_relaxed);
+        }
+    }
+    cell->event = event;
+    cell->sequence.store(position + 1, memory_order_release);
+    return true;
+}
+
+// Must not be called by two threads at once.
+bool EventQueue::pop(Event* event) {
+    Cell* cell = &cells[popPosition & EVENT_QUEUE_MASK];
+    size_t sequence = cell->sequence.load(memory_order_acquire);
+    if (sequence != popPosition + 1)
+        return false;
+    *event = cell->event;
+    cell->sequence.store(popPosition + EVENT_QUEUE_CAPACITY,
+                         memory_order_release);
+    popPosition++;
+    return true;
+}
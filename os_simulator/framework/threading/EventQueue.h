@@ -0,0 +1,56 @@
+#ifndef OS_THREADING_EVENTQUEUE_H
+#define OS_THREADING_EVENTQUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+#include "Thread.h"
+#include "ThreadingConstants.h"
+
+using namespace std;
+
+namespace Threading {
+
+typedef enum EventType { EVENT_CREATE, EVENT_PRIORITY } EventType;
+
+/**
+ * A change to the scheduler's state that does not have to be made by the
+ * thread asking for it.
+ *
+ * @param type What to do.
+ * @param thread The thread to create, or the thread whose priority changes.
+ * @param priority The new priority of an EVENT_PRIORITY.
+ */
+typedef struct Event {
+    EventType type;
+    Thread* thread;
+    int priority;
+} Event;
+
+/**
+ * A bounded queue of events that any number of threads push to without
+ * taking a lock, and that one thread at a time pops from. Pushing reserves a
+ * slot with a compare-and-swap and then publishes the event in it; events
+ * come out in the order their slots were reserved. A pusher stopped between
+ * the two steps holds back the events behind it until it carries on, but
+ * none are lost.
+ */
+class EventQueue {
+   public:
+    EventQueue();
+    ~EventQueue();
+    bool push(const Event& event);
+    bool pop(Event* event);
+
+   private:
+    typedef struct Cell {
+        atomic<size_t> sequence;
+        Event event;
+    } Cell;
+
+    Cell* cells;
+    atomic<size_t> pushPosition;
+    size_t popPosition;
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_EVENTQUEUE_H
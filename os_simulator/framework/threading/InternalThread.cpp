@@ -1,25 +1,40 @@
 #include "InternalThread.h"
 #include <signal.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <cerrno>
 #include <iostream>
+#include "SimulatorContext.h"
 #include "io/InternalLogger.h"
 
 using namespace Threading;
 using namespace std;
 
+thread_local InternalThread* InternalThread::currentThread = NULL;
+
 InternalThread::InternalThread(void* (*func)(void*), void* arg) {
     signal(SIGUSR1, ThreadManager::signalFunc);
     signal(SIGUSR2, ThreadManager::signalFunc);
     this->func = func;
     this->arg = arg;
     externalThread = NULL;
+    simulator = Simulator::current();
     pthread_mutex_init(&sleepMutex, NULL);
     pthread_mutex_init(&stateMutex, NULL);
     pthread_mutex_init(&signalMutex, NULL);
     pthread_mutex_init(&stopExecutionMutex, NULL);
     pthread_cond_init(&stopExecutionCond, NULL);
+    pthread_cond_init(&stateCond, NULL);
+    pthread_cond_init(&sliceEndCond, NULL);
     currentState = CREATED;
+    parked = false;
+    sequence = -1;
+    calls = 0;
+    sliceCalls = 0;
+    callLimit = NO_CALL_LIMIT;
+    callDepth = 0;
+    pausePending = false;
 }
 
 InternalThread::InternalThread(void* (*func)(void*),
@@ -32,11 +47,29 @@ InternalThread::InternalThread(void* (*func)(void*),
 
 InternalThread::~InternalThread() {}
 
+// Readies a thread that has ended and been joined to run another Thread. Its
+// mutexes and condition variables are all released by then and are kept.
+void InternalThread::reuse(void* (*func)(void*),
+                           void* arg,
+                           Thread* externalThread) {
+    this->func = func;
+    this->arg = arg;
+    this->externalThread = externalThread;
+    this->externalThread->state = CREATED;
+    currentState = CREATED;
+    parked = false;
+    sequence = -1;
+    calls = 0;
+    sliceCalls = 0;
+    callLimit = NO_CALL_LIMIT;
+    callDepth = 0;
+    pausePending = false;
+}
+
+// The state is read without stateMutex, which only orders changes with the
+// waits on stateCond, so reading it is safe from the signal handler too.
 State InternalThread::getState() {
-    pthread_mutex_lock(&stateMutex);
-    State ret = currentState;
-    pthread_mutex_unlock(&stateMutex);
-    return ret;
+    return currentState;
 }
 
 void InternalThread::setState(State newState) {
@@ -44,6 +77,7 @@ void InternalThread::setState(State newState) {
     currentState = newState;
     if (externalThread != NULL)
         externalThread->state = newState;
+    pthread_cond_broadcast(&stateCond);
     pthread_mutex_unlock(&stateMutex);
 }
 
@@ -55,6 +89,10 @@ void InternalThread::runningSigFunc(int sig) {
             << externalThread->name << "\n";
         InternalLogger::getLogger().flush();
     }
+    // A thread that has returned from its function is on its way out and must
+    // not be parked again; the dispatcher treats TERMINATED as final.
+    if (getState() == TERMINATED)
+        return;
     if (sig == SIGUSR1) {
         if (InternalLogger::getLogger().isVerbose()) {
             InternalLogger::eventSink()
@@ -62,33 +100,60 @@ void InternalThread::runningSigFunc(int sig) {
                 << " so pausing thread " << externalThread->name << "\n";
             InternalLogger::getLogger().flush();
         }
-        setState(PAUSED);
-        sigset_t sigSet;
-        sigemptyset(&sigSet);
-        sigaddset(&sigSet, SIGUSR2);
-
-        bool cont = true;
-        while (cont) {
-            int sig;
-            int ret = sigwait(&sigSet, &sig);
-            if (ret == 0 && sig == SIGUSR2) {
-                setState(RUNNING);
-                pthread_mutex_lock(&stopExecutionMutex);
-                pthread_cond_signal(&stopExecutionCond);
-                pthread_mutex_unlock(&stopExecutionMutex);
-                cont = false;
-            }
+        // A call into the simulator is not interrupted, so a replay sees it
+        // happen in the same slice as the recording did; leaveCall pauses.
+        if (callDepth > 0) {
+            pausePending = true;
+            return;
         }
+        pauseUntilResumed();
     }
 }
 
+void InternalThread::pauseUntilResumed() {
+    // SIGUSR2 must be blocked before PAUSED is published, otherwise a resume
+    // sent in between is consumed by the handler and lost.
+    sigset_t sigSet;
+    sigset_t oldSet;
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &sigSet, &oldSet);
+    setState(PAUSED);
+
+    bool cont = true;
+    while (cont) {
+        int sig;
+        int ret = sigwait(&sigSet, &sig);
+        if (ret == 0 && sig == SIGUSR2) {
+            // Clear parked before RUNNING is visible so the dispatcher never
+            // sees a resumed thread as still parked. The handler may have
+            // interrupted stopExecution while it holds stopExecutionMutex, so
+            // the flag is the predicate and the mutex is not taken here.
+            parked = false;
+            pthread_cond_signal(&stopExecutionCond);
+            setState(RUNNING);
+            cont = false;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+}
+
 void InternalThread::exit() {
     terminated();
     pthread_exit(NULL);
 }
 
 int InternalThread::joinWithTimeout() {
-    return pthread_timedjoin_np(thread, NULL, &THREAD_JOIN_TIMEOUT);
+    // pthread_timedjoin_np takes an absolute CLOCK_REALTIME deadline.
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += THREAD_JOIN_TIMEOUT.tv_sec;
+    deadline.tv_nsec += THREAD_JOIN_TIMEOUT.tv_nsec;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_timedjoin_np(thread, NULL, &deadline);
 }
 
 // Yes, good work searching for "point" but there are none in this file.
@@ -99,10 +164,13 @@ int InternalThread::join() {
 
 void InternalThread::terminated() {
     setState(TERMINATED);
+    pthread_mutex_lock(&stopExecutionMutex);
+    pthread_cond_broadcast(&sliceEndCond);
+    pthread_mutex_unlock(&stopExecutionMutex);
 }
 
 void InternalThread::sendSignal(int sig, State waitForState) {
-    pthread_mutex_lock(&ThreadManager::threadSignalMutex);
+    pthread_mutex_lock(&signalMutex);
     if (InternalLogger::getLogger().isVerbose()) {
         InternalLogger::eventSink()
             << "[InternalThread] "
@@ -110,37 +178,56 @@ void InternalThread::sendSignal(int sig, State waitForState) {
             << externalThread->name << "\n";
         InternalLogger::getLogger().flush();
     }
-    ThreadManager::threadToSignal = this;
     pthread_kill(thread, sig);
-    State state = getState();
-    while (state != waitForState) {
-        usleep(MICROSECONDS_TICK);
-        if (InternalLogger::getLogger().isVerbose()) {
+    // The handler publishes every state change through stateCond, so this
+    // only falls back to the timeout when a signal is slow to be delivered.
+    pthread_mutex_lock(&stateMutex);
+    State state = currentState;
+    while (state != waitForState && state != TERMINATED) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += MICROSECONDS_TICK * 1000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        int waited = pthread_cond_timedwait(&stateCond, &stateMutex, &deadline);
+        state = currentState;
+        if (waited == ETIMEDOUT && state != waitForState &&
+            InternalLogger::getLogger().isVerbose()) {
             InternalLogger::eventSink()
                 << "[InternalThread] "
                 << "Goal state (" << waitForState << ") != current state ("
                 << state << ") for thread " << externalThread->name << "\n";
             InternalLogger::getLogger().flush();
         }
-        state = getState();
     }
-    ThreadManager::threadToSignal = NULL;
+    pthread_mutex_unlock(&stateMutex);
     if (InternalLogger::getLogger().isVerbose()) {
         InternalLogger::eventSink() << "[InternalThread] "
                                     << "Thread " << externalThread->name
                                     << " in state " << waitForState << "\n";
         InternalLogger::getLogger().flush();
     }
-    pthread_mutex_unlock(&ThreadManager::threadSignalMutex);
+    pthread_mutex_unlock(&signalMutex);
 }
 
 void InternalThread::pause() {
     sendSignal(SIGUSR1, PAUSED);
 }
 
+// The new thread starts with the pause and resume signals blocked, so any
+// that arrive before it knows which thread it is wait until it does.
 void InternalThread::start() {
     setState(RUNNING);
+    sigset_t sigSet;
+    sigset_t oldSet;
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, SIGUSR1);
+    sigaddset(&sigSet, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &sigSet, &oldSet);
     pthread_create(&thread, NULL, &InternalThread::startThread, this);
+    pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
 }
 
 void InternalThread::resume() {
@@ -149,13 +236,137 @@ void InternalThread::resume() {
 
 void* InternalThread::startThread(void* thread) {
     InternalThread* actualThread = ((InternalThread*)thread);
-    return actualThread->func(actualThread->arg);
+    Simulator::bind(actualThread->simulator);
+    currentThread = actualThread;
+    sigset_t sigSet;
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, SIGUSR1);
+    sigaddset(&sigSet, SIGUSR2);
+    pthread_sigmask(SIG_UNBLOCK, &sigSet, NULL);
+    void* ret = actualThread->func(actualThread->arg);
+    // Returning counts as a call, so a replayed slice that ended before it
+    // does not let the thread end early.
+    callPoint();
+    // A pause arriving now would interrupt terminated() while it holds
+    // stateMutex, so the thread stops taking signals before it reports.
+    pthread_sigmask(SIG_BLOCK, &sigSet, NULL);
+    actualThread->terminated();
+    return ret;
 }
 
+// A parked thread is paused as soon as the dispatcher asks, even in the middle
+// of a call.
 void InternalThread::stopExecution() {
+    int depth = callDepth;
+    callDepth = 0;
+    atomic_signal_fence(memory_order_seq_cst);
+    pthread_mutex_lock(&stopExecutionMutex);
+    parked = true;
+    pthread_cond_broadcast(&sliceEndCond);
+    while (parked) {
+        pthread_cond_wait(&stopExecutionCond, &stopExecutionMutex);
+    }
+    pthread_mutex_unlock(&stopExecutionMutex);
+    callDepth = depth;
+    atomic_signal_fence(memory_order_seq_cst);
+}
+
+bool InternalThread::isParked() {
+    return parked;
+}
+
+// Whether a thread left running at the end of its slice can go on without
+// being paused. Parking takes stopExecutionMutex, so a thread is either seen
+// parked here or parks later and is paused at the end of the slice it is
+// given; either way its stopExecution only returns through a resume.
+bool InternalThread::keepsRunning() {
+    pthread_mutex_lock(&stopExecutionMutex);
+    bool running = !parked && getState() == RUNNING;
+    pthread_mutex_unlock(&stopExecutionMutex);
+    return running;
+}
+
+bool InternalThread::waitForSliceEnd(int ticks) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long long nanos =
+        deadline.tv_nsec + (long long)ticks * MICROSECONDS_TICK * 1000;
+    deadline.tv_sec += nanos / 1000000000L;
+    deadline.tv_nsec = nanos % 1000000000L;
     pthread_mutex_lock(&stopExecutionMutex);
-    pthread_cond_wait(&stopExecutionCond, &stopExecutionMutex);
+    bool ended = parked || getState() == TERMINATED;
+    int waited = 0;
+    while (!ended && waited != ETIMEDOUT) {
+        waited = pthread_cond_timedwait(&sliceEndCond, &stopExecutionMutex,
+                                        &deadline);
+        ended = parked || getState() == TERMINATED;
+    }
     pthread_mutex_unlock(&stopExecutionMutex);
+    return ended;
+}
+
+// The InternalThread running on the calling pthread, NULL for threads the
+// simulator did not start.
+InternalThread* InternalThread::current() {
+    return currentThread;
+}
+
+int InternalThread::getSequence() {
+    return sequence;
+}
+
+void InternalThread::setSequence(int sequence) {
+    this->sequence = sequence;
+}
+
+// Lets the thread make count more calls in its next slice before it parks, or
+// as many as it likes if count is negative. Set before the slice starts.
+void InternalThread::allowCalls(int count) {
+    callLimit = count < 0 ? NO_CALL_LIMIT : sliceCalls + count;
+}
+
+// The calls the thread made since the last time this was asked, which the
+// dispatcher does once each slice has ended.
+int InternalThread::takeSliceCalls() {
+    long made = calls;
+    int taken = (int)(made - sliceCalls);
+    sliceCalls = made;
+    return taken;
+}
+
+// Calls into the simulator are what a replay counts to end a slice where the
+// recording did: a thread that has used up its calls parks before making
+// another. Outside threads are not counted.
+void InternalThread::enterCall() {
+    InternalThread* thread = currentThread;
+    if (thread == NULL)
+        return;
+    // Counted only once a pause can no longer come between the count and
+    // the call.
+    if (++thread->callDepth == 1) {
+        atomic_signal_fence(memory_order_seq_cst);
+        long limit;
+        while ((limit = thread->callLimit) != NO_CALL_LIMIT &&
+               thread->calls >= limit) {
+            thread->stopExecution();
+        }
+        thread->calls++;
+    }
+    atomic_signal_fence(memory_order_seq_cst);
+}
+
+void InternalThread::leaveCall() {
+    InternalThread* thread = currentThread;
+    if (thread == NULL)
+        return;
+    atomic_signal_fence(memory_order_seq_cst);
+    if (--thread->callDepth == 0 && thread->pausePending.exchange(false))
+        thread->pauseUntilResumed();
+}
+
+void InternalThread::callPoint() {
+    enterCall();
+    leaveCall();
 }
 
 Thread* InternalThread::getExternalThread() {
@@ -2,17 +2,20 @@
 #define OS_THREADING_THREAD_H
 
 #include <pthread.h>
+#include <atomic>
 #include <cstdlib>
 #include "Thread.h"
 #include "ThreadingConstants.h"
 
 using namespace std;
+struct Simulator;
 namespace Threading {
 class InternalThread {
    public:
     InternalThread(void* (*func)(void*), void* arg);
     InternalThread(void* (*func)(void*), void* arg, Thread* externalThread);
     ~InternalThread();
+    void reuse(void* (*func)(void*), void* arg, Thread* externalThread);
     void terminated();
     void pause();
     void resume();
@@ -24,6 +27,17 @@ class InternalThread {
     Thread* getExternalThread();
     void runningSigFunc(int sig);
     void stopExecution();
+    bool isParked();
+    bool keepsRunning();
+    bool waitForSliceEnd(int ticks);
+    int getSequence();
+    void setSequence(int sequence);
+    void allowCalls(int count);
+    int takeSliceCalls();
+    static InternalThread* current();
+    static void enterCall();
+    static void leaveCall();
+    static void callPoint();
 
    private:
     pthread_t thread;
@@ -32,15 +46,39 @@ class InternalThread {
     pthread_mutex_t signalMutex;
     pthread_mutex_t stopExecutionMutex;
     pthread_cond_t stopExecutionCond;
+    pthread_cond_t stateCond;
+    pthread_cond_t sliceEndCond;
 
-    State currentState;
+    atomic<State> currentState;
+    atomic<bool> parked;
+    int sequence;
+    // Calls into the simulator the thread has made, how many it had made when
+    // its last slice ended, and how many it may make before it parks, or
+    // NO_CALL_LIMIT. A pause that arrives during a call waits for its end.
+    atomic<long> calls;
+    long sliceCalls;
+    atomic<long> callLimit;
+    int callDepth;
+    atomic<bool> pausePending;
     void* (*func)(void*);
     void sendSignal(int sig, State waitForState);
 
     void setState(State newState);
+    void pauseUntilResumed();
     static void* startThread(void* thread);
     void* arg;
     Thread* externalThread;
+    Simulator* simulator;
+    static thread_local InternalThread* currentThread;
+};
+
+/**
+ * Marks a call into the simulator by a simulated thread for as long as it is
+ * in scope; see InternalThread::enterCall.
+ */
+struct SimulatorCall {
+    SimulatorCall() { InternalThread::enterCall(); }
+    ~SimulatorCall() { InternalThread::leaveCall(); }
 };
 }  // namespace Threading
 
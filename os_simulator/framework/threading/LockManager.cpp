@@ -1,96 +1,678 @@
 #include "ThreadManager.h"
 
-#include <uuid/uuid.h>
-
-// TODO: Factor this out into a separate header instead of duplicating it.
-#ifndef UUID_LENGTH
-// 36 bytes and a null character
-#define UUID_LENGTH 37
-#endif
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include "SimulatorContext.h"
 
 using namespace Threading;
 
-LockManager* LockManager::singleton = NULL;
+// A plain lock keeps its state in one word: 0 when free, otherwise the holding
+// Thread*, or OUTSIDE_HOLDER for a thread outside the simulation. CONTENDED is
+// set while threads wait for it; the holder then has to release it under the
+// table mutex so the lock can be handed over.
+static const uintptr_t CONTENDED = 1;
+static const uintptr_t OUTSIDE_HOLDER = 2;
+static const uintptr_t NAME_COOKIE = (uintptr_t)0x4c6f636b4e616d65ULL;
+
+static uintptr_t holderWord(Thread* thread) {
+    return thread == NULL ? OUTSIDE_HOLDER : (uintptr_t)thread;
+}
+
+static Thread* wordHolder(uintptr_t word) {
+    word &= ~CONTENDED;
+    return word == OUTSIDE_HOLDER ? NULL : (Thread*)word;
+}
+
+// The callbacks in Lock.student.h belong to one simulator at a time.
+static bool reachesCallbacks() {
+    return Simulator::current()->reachesCallbacks();
+}
+
+// Like the policy mutex, the table mutex must not be held by a thread the
+// dispatcher pauses, or every other thread touching a lock would stall.
+void LockManager::lockTable(sigset_t* oldSet) {
+    sigset_t sigSet;
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &sigSet, oldSet);
+    pthread_mutex_lock(&tableMutex);
+}
+
+void LockManager::unlockTable(sigset_t* oldSet) {
+    pthread_mutex_unlock(&tableMutex);
+    pthread_sigmask(SIG_SETMASK, oldSet, NULL);
+}
+
+const char* LockManager::create(bool readWrite, bool preferWriters) {
+    SimLock* simLock = new SimLock();
+    simLock->name.simLock = simLock;
+    simLock->name.cookie = (uintptr_t)&simLock->name ^ NAME_COOKIE;
+    writeUuid(simLock->name.id);
+    simLock->word = 0;
+    simLock->fastAcquisitions = 0;
+    simLock->held = false;
+    simLock->destroyed = false;
+    simLock->owner = NULL;
+    simLock->readWrite = readWrite;
+    simLock->preferWriters = preferWriters;
+    simLock->outsideReaders = 0;
+    simLock->stats = LockStats();
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    locks[simLock->name.id] = simLock;
+    unlockTable(&oldSet);
+    return simLock->name.id;
+}
 
 const char* LockManager::createLock() {
-    uuid_t uuid;
-    uuid_generate(uuid);
-    char* id = new char[UUID_LENGTH]();
-    uuid_unparse(uuid, id);
-    pthread_mutex_t* mutex = new pthread_mutex_t();
-    pthread_mutex_init(mutex, NULL);
-    locks[id] = mutex;
-    lockCreated(id);
+    const char* id = create(false, false);
+    if (reachesCallbacks())
+        lockCreated(id);
     return id;
 }
 
+const char* LockManager::createReadWriteLock(bool preferWriters) {
+    return create(true, preferWriters);
+}
+
+// Expects the table mutex to be held.
+LockManager::SimLock* LockManager::find(const char* lockId) {
+    map<const char*, SimLock*>::iterator found = locks.find(lockId);
+    return found == locks.end() ? NULL : found->second;
+}
+
+// The lock an id names. An id returned by createLock or createReadWriteLock
+// is found without the table mutex, even after the lock is destroyed; any
+// other string is looked up in the table, which only knows those ids.
+LockManager::SimLock* LockManager::named(const char* lockId) {
+    if (lockId == NULL)
+        return NULL;
+    const char* start = lockId - offsetof(LockName, id);
+    uintptr_t cookie;
+    memcpy(&cookie, start + offsetof(LockName, cookie), sizeof(cookie));
+    if (cookie == ((uintptr_t)start ^ NAME_COOKIE))
+        return ((const LockName*)start)->simLock;
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SimLock* simLock = find(lockId);
+    unlockTable(&oldSet);
+    return simLock;
+}
+
+// Expects the table mutex to be held. The holder of a plain lock is only
+// tracked while others wait for it; without waiters it may release the lock on
+// the fast path.
+void LockManager::take(SimLock* simLock, Thread* thread) {
+    if (!simLock->readWrite) {
+        bool contended = !simLock->waiters.empty();
+        simLock->word = holderWord(thread) | (contended ? CONTENDED : 0);
+        if (contended && thread != NULL)
+            heldLocks[thread].insert(simLock);
+        return;
+    }
+    simLock->held = true;
+    simLock->owner = thread;
+    if (thread != NULL)
+        heldLocks[thread].insert(simLock);
+}
+
+void LockManager::share(SimLock* simLock, Thread* thread) {
+    if (thread == NULL) {
+        simLock->outsideReaders++;
+        return;
+    }
+    simLock->readers.insert(thread);
+    heldLocks[thread].insert(simLock);
+}
+
+// Forgets that the thread holds the lock; the lock itself is left alone.
+void LockManager::release(SimLock* simLock, Thread* thread) {
+    map<Thread*, set<SimLock*>>::iterator held = heldLocks.find(thread);
+    if (held == heldLocks.end())
+        return;
+    held->second.erase(simLock);
+    if (held->second.empty())
+        heldLocks.erase(held);
+}
+
+// Expects the table mutex to be held.
+Thread* LockManager::holderOf(SimLock* simLock) {
+    if (simLock->readWrite)
+        return simLock->owner;
+    return wordHolder(simLock->word);
+}
+
+bool LockManager::isFree(SimLock* simLock) {
+    if (!simLock->readWrite)
+        return simLock->word == 0;
+    return !simLock->held && simLock->readers.empty() &&
+           simLock->outsideReaders == 0;
+}
+
+// Whether a thread asking for a shared hold gets it right away.
+bool LockManager::canShare(SimLock* simLock) {
+    return !simLock->held &&
+           !(simLock->preferWriters && !simLock->waiters.empty());
+}
+
+// Expects the table mutex to be held. waitStart is the tick the thread started
+// waiting on, or -1 if it did not have to.
+void LockManager::recordAcquisition(SimLock* simLock,
+                                    bool shared,
+                                    int waitStart) {
+    LockStats* stats = &simLock->stats;
+    stats->acquisitions++;
+    if (shared)
+        stats->sharedAcquisitions++;
+    if (waitStart < 0)
+        return;
+    int waited = ThreadManager::getInstance()->currentTick() - waitStart;
+    stats->contentions++;
+    stats->waitTicks += waited;
+    contentions.fetch_add(1, memory_order_relaxed);
+    waitTicks.fetch_add(waited, memory_order_relaxed);
+    if (waited > stats->maxWaitTicks)
+        stats->maxWaitTicks = waited;
+}
+
+// Expects the table and policy mutexes to be held. The thread table remembers
+// the priority the thread had before its first donation so it can be given
+// back.
+void LockManager::raise(Thread* thread, int priority) {
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    threadManager->table.markDonated(thread);
+    threadManager->changePriority(thread, priority);
+}
+
+// Expects the table and policy mutexes to be held. Every holder of the lock
+// gets the donor's priority, and so on down the chain of holders that are
+// waiting for locks themselves, as the thread table has them. Returns how
+// many threads were raised.
+int LockManager::donate(Thread* donor, SimLock* simLock, int depth) {
+    if (simLock == NULL || depth >= MAX_DONATION_DEPTH)
+        return 0;
+    ThreadTable& table = ThreadManager::getInstance()->table;
+    vector<Thread*> holders(simLock->readers.begin(), simLock->readers.end());
+    if (holderOf(simLock) != NULL)
+        holders.push_back(holderOf(simLock));
+    int raised = 0;
+    for (vector<Thread*>::iterator iter = holders.begin();
+         iter != holders.end(); iter++) {
+        Thread* holder = *iter;
+        if (holder->priority >= donor->priority)
+            continue;
+        raise(holder, donor->priority);
+        raised++;
+        SimLock* waitingFor = find(table.blockedOnLock(holder));
+        raised += donate(donor, waitingFor, depth + 1);
+    }
+    return raised;
+}
+
+// Expects the table and policy mutexes to be held. The highest priority
+// waiting for any lock the thread holds, or MIN_PRI - 1 if nobody is.
+int LockManager::inheritedPriority(Thread* thread) {
+    map<Thread*, set<SimLock*>>::iterator held = heldLocks.find(thread);
+    if (held == heldLocks.end())
+        return MIN_PRI - 1;
+    donors.clear();
+    for (set<SimLock*>::iterator iter = held->second.begin();
+         iter != held->second.end(); iter++) {
+        Thread* writer = (*iter)->waiters.top();
+        if (writer != NULL)
+            donors.push_back(writer->priority);
+        Thread* reader = (*iter)->readWaiters.top();
+        if (reader != NULL)
+            donors.push_back(reader->priority);
+    }
+    int best = kernels->argmax(donors.data(), donors.size());
+    return best == -1 ? MIN_PRI - 1 : donors[best];
+}
+
+// Expects the table and policy mutexes to be held. Gives the thread back the
+// priority it had before any donation, or what the waiters of the locks it
+// still holds donate if that is more.
+void LockManager::restorePriority(Thread* thread) {
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    int base;
+    if (!threadManager->table.donatedFrom(thread, &base))
+        return;
+    int priority = max(base, inheritedPriority(thread));
+    if (heldLocks.find(thread) == heldLocks.end())
+        threadManager->table.clearDonation(thread);
+    threadManager->changePriority(thread, priority);
+}
+
+// Expects the table and policy mutexes to be held and the lock to be free.
+// Hands the lock straight to the highest priority waiter so nobody can slip in
+// before it runs, and passes on what the others donate. A reader-writer lock
+// goes to one writer or to every waiting reader at once; with preferWriters
+// the writers go first whatever their priority.
+void LockManager::handOff(SimLock* simLock) {
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    vector<Thread*> granted;
+    Thread* writer = simLock->waiters.top();
+    Thread* reader = simLock->readWaiters.top();
+    if (writer != NULL && (reader == NULL || simLock->preferWriters ||
+                           writer->priority >= reader->priority)) {
+        threadManager->wakeFrom(&simLock->waiters);
+        take(simLock, writer);
+        granted.push_back(writer);
+    } else {
+        while ((reader = threadManager->wakeFrom(&simLock->readWaiters)) !=
+               NULL) {
+            share(simLock, reader);
+            granted.push_back(reader);
+        }
+    }
+    for (vector<Thread*>::iterator iter = granted.begin();
+         iter != granted.end(); iter++) {
+        int inherited = inheritedPriority(*iter);
+        if (inherited > (*iter)->priority) {
+            raise(*iter, inherited);
+            simLock->stats.donations++;
+        }
+    }
+}
+
+// An uncontended lock is taken with a single compare-and-swap, without the
+// table mutex, and none of the callbacks run; they only hear about a lock once
+// a thread has to wait for it.
 bool LockManager::lock(const char* lockId) {
+    return lockWithTimeout(lockId, -1);
+}
+
+bool LockManager::tryLock(const char* lockId) {
+    return lockWithTimeout(lockId, 0);
+}
+
+bool LockManager::lockWithTimeout(const char* lockId, int ticks) {
+    ThreadManager* threadManager = ThreadManager::getInstance();
     Thread* currentThread =
-        ThreadManager::getInstance()->currentThread()->getExternalThread();
-    if (locks.count(lockId) == 1) {
+        threadManager->currentThread()->getExternalThread();
+    SimLock* simLock = named(lockId);
+    if (simLock == NULL) {
+        if (reachesCallbacks())
+            lockFailed(lockId, currentThread);
+        return false;
+    }
+    if (simLock->readWrite)
+        return false;
+    uintptr_t expected = 0;
+    if (simLock->word.compare_exchange_strong(expected,
+                                              holderWord(currentThread))) {
+        simLock->fastAcquisitions++;
+        return true;
+    }
+    if (ticks == 0) {
+        // Only a destroyed lock is contended without a holder.
+        if (expected == CONTENDED && reachesCallbacks())
+            lockFailed(lockId, currentThread);
+        return false;
+    }
+    return lockContended(lockId, simLock, currentThread, ticks);
+}
+
+// Waits for the lock for up to ticks ticks, or for as long as it takes if
+// ticks is negative.
+bool LockManager::lockContended(const char* lockId,
+                                SimLock* simLock,
+                                Thread* currentThread,
+                                int ticks) {
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    bool callbacks = reachesCallbacks();
+    if (callbacks)
         lockAttempted(lockId, currentThread);
-        if (pthread_mutex_lock(locks[lockId]) == 0) {
-            lockAcquired(lockId, currentThread);
-            return true;
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    int waitStart = threadManager->currentTick();
+    int deadline = ticks < 0 ? NO_WAKE_TICK : waitStart + ticks;
+    bool waited = false;
+    uintptr_t word = simLock->word;
+    while (!simLock->destroyed) {
+        if (word == 0) {
+            if (simLock->word.compare_exchange_weak(word,
+                                                    holderWord(currentThread)))
+                break;
+            continue;
+        }
+        waited = true;
+        // Only simulated threads can be put to sleep by the scheduler; anyone
+        // else checks back every tick.
+        if (currentThread == NULL) {
+            if (deadline != NO_WAKE_TICK &&
+                threadManager->currentTick() >= deadline)
+                break;
+            unlockTable(&oldSet);
+            usleep(MICROSECONDS_TICK);
+            lockTable(&oldSet);
+            word = simLock->word;
+            continue;
+        }
+        // Once CONTENDED is set the holder cannot release the lock without
+        // the table mutex, so it is safe to queue up behind it.
+        if ((word & CONTENDED) == 0 &&
+            !simLock->word.compare_exchange_weak(word, word | CONTENDED))
+            continue;
+        Thread* holder = wordHolder(word);
+        if (holder != NULL)
+            heldLocks[holder].insert(simLock);
+
+        sigset_t policySet;
+        threadManager->lockPolicy(&policySet);
+        simLock->stats.donations += donate(currentThread, simLock, 0);
+        // Queued before the table mutex goes, so an unlock cannot miss it. The
+        // ThreadManager takes the thread back out of the queue at the deadline.
+        threadManager->blockOn(&simLock->waiters, deadline, lockId);
+        threadManager->unlockPolicy(&policySet);
+        unlockTable(&oldSet);
+        threadManager->parkCurrentThread();
+
+        // unlock handed the lock over before waking this thread, unless the
+        // lock was destroyed or the wait timed out.
+        lockTable(&oldSet);
+        if (!simLock->destroyed && wordHolder(simLock->word) != currentThread) {
+            // What the thread donated is no longer owed.
+            threadManager->lockPolicy(&policySet);
+            holder = wordHolder(simLock->word);
+            if (holder != NULL)
+                restorePriority(holder);
+            threadManager->unlockPolicy(&policySet);
         }
+        break;
+    }
+    bool acquired = !simLock->destroyed &&
+                    (simLock->word & ~CONTENDED) == holderWord(currentThread);
+    if (acquired)
+        recordAcquisition(simLock, false, waited ? waitStart : -1);
+    unlockTable(&oldSet);
+    if (!acquired) {
+        if (callbacks)
+            lockFailed(lockId, currentThread);
+        return false;
     }
-    lockFailed(lockId, currentThread);
-    return false;
+    if (callbacks)
+        lockAcquired(lockId, currentThread);
+    return true;
 }
 
+// Releasing a lock nobody waits for is a single compare-and-swap as well. A
+// contended lock goes to its first waiter and lockReleased is called.
 bool LockManager::unlock(const char* lockId) {
-    if (locks.count(lockId) == 1) {
-        if (pthread_mutex_unlock(locks[lockId]) == 0) {
-            lockReleased(lockId, ThreadManager::getInstance()
-                                     ->currentThread()
-                                     ->getExternalThread());
-            return true;
-        }
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    Thread* currentThread =
+        threadManager->currentThread()->getExternalThread();
+    SimLock* simLock = named(lockId);
+    if (simLock == NULL || simLock->readWrite)
+        return false;
+    uintptr_t expected = holderWord(currentThread);
+    if (simLock->word.compare_exchange_strong(expected, 0))
+        return true;
+
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    // Any thread may release a lock, as it always could.
+    uintptr_t word = simLock->word;
+    while (!simLock->destroyed && word != 0 && (word & CONTENDED) == 0 &&
+           !simLock->word.compare_exchange_weak(word, 0)) {
+    }
+    if (simLock->destroyed || word == 0) {
+        unlockTable(&oldSet);
+        return false;
+    }
+    if ((word & CONTENDED) == 0) {
+        unlockTable(&oldSet);
+        return true;
+    }
+    release(simLock, wordHolder(word));
+    // Waiters that time out leave the queue under the policy mutex alone.
+    sigset_t policySet;
+    threadManager->lockPolicy(&policySet);
+    if (simLock->waiters.empty())
+        simLock->word = 0;
+    else
+        handOff(simLock);
+    threadManager->unlockPolicy(&policySet);
+    unlockTable(&oldSet);
+    if (reachesCallbacks())
+        lockReleased(lockId, currentThread);
+
+    // lockReleased drops the thread back to its original priority, but locks
+    // it still holds may have waiters donating to it.
+    if (currentThread != NULL) {
+        lockTable(&oldSet);
+        threadManager->lockPolicy(&policySet);
+        int inherited = inheritedPriority(currentThread);
+        if (inherited > currentThread->priority)
+            raise(currentThread, inherited);
+        else if (heldLocks.find(currentThread) == heldLocks.end())
+            threadManager->table.clearDonation(currentThread);
+        threadManager->unlockPolicy(&policySet);
+        unlockTable(&oldSet);
+    }
+    return true;
+}
+
+bool LockManager::lockShared(const char* lockId) {
+    return lockReadWrite(lockId, true);
+}
+
+bool LockManager::lockExclusive(const char* lockId) {
+    return lockReadWrite(lockId, false);
+}
+
+bool LockManager::unlockShared(const char* lockId) {
+    return unlockReadWrite(lockId, true);
+}
+
+bool LockManager::unlockExclusive(const char* lockId) {
+    return unlockReadWrite(lockId, false);
+}
+
+// Waits the way lock does, on readWaiters for a shared hold and on waiters for
+// an exclusive one. A waiting thread donates to every holder.
+bool LockManager::lockReadWrite(const char* lockId, bool shared) {
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    Thread* currentThread =
+        threadManager->currentThread()->getExternalThread();
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SimLock* simLock = find(lockId);
+    if (simLock == NULL || !simLock->readWrite) {
+        unlockTable(&oldSet);
+        return false;
+    }
+    int waitStart = -1;
+    while (currentThread == NULL && !simLock->destroyed &&
+           !(shared ? canShare(simLock) : isFree(simLock))) {
+        if (waitStart < 0)
+            waitStart = threadManager->currentTick();
+        unlockTable(&oldSet);
+        usleep(MICROSECONDS_TICK);
+        lockTable(&oldSet);
+    }
+    if (simLock->destroyed) {
+        unlockTable(&oldSet);
+        return false;
+    }
+    if (shared ? canShare(simLock) : isFree(simLock)) {
+        if (shared)
+            share(simLock, currentThread);
+        else
+            take(simLock, currentThread);
+        recordAcquisition(simLock, shared, waitStart);
+        unlockTable(&oldSet);
+        return true;
+    }
+
+    waitStart = threadManager->currentTick();
+    sigset_t policySet;
+    threadManager->lockPolicy(&policySet);
+    simLock->stats.donations += donate(currentThread, simLock, 0);
+    threadManager->blockOn(shared ? &simLock->readWaiters : &simLock->waiters,
+                           NO_WAKE_TICK, lockId);
+    threadManager->unlockPolicy(&policySet);
+    unlockTable(&oldSet);
+    threadManager->parkCurrentThread();
+
+    lockTable(&oldSet);
+    bool acquired = !simLock->destroyed &&
+                    (shared ? simLock->readers.count(currentThread) == 1
+                            : simLock->owner == currentThread);
+    if (acquired)
+        recordAcquisition(simLock, shared, waitStart);
+    unlockTable(&oldSet);
+    return acquired;
+}
+
+bool LockManager::unlockReadWrite(const char* lockId, bool shared) {
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    Thread* currentThread =
+        threadManager->currentThread()->getExternalThread();
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SimLock* simLock = find(lockId);
+    bool holds = false;
+    if (simLock != NULL && simLock->readWrite) {
+        if (!shared)
+            holds = simLock->held && simLock->owner == currentThread;
+        else if (currentThread == NULL)
+            holds = simLock->outsideReaders > 0;
+        else
+            holds = simLock->readers.count(currentThread) == 1;
+    }
+    if (!holds) {
+        unlockTable(&oldSet);
+        return false;
+    }
+    if (!shared) {
+        simLock->held = false;
+        simLock->owner = NULL;
+    } else if (currentThread == NULL) {
+        simLock->outsideReaders--;
+    } else {
+        simLock->readers.erase(currentThread);
+    }
+    release(simLock, currentThread);
+
+    bool wake = isFree(simLock) && (!simLock->waiters.empty() ||
+                                    !simLock->readWaiters.empty());
+    // Whether anything was donated is up to the thread table, which is only
+    // read with the policy mutex held.
+    bool restore = currentThread != NULL;
+    if (wake || restore) {
+        sigset_t policySet;
+        threadManager->lockPolicy(&policySet);
+        if (wake)
+            handOff(simLock);
+        if (restore)
+            restorePriority(currentThread);
+        threadManager->unlockPolicy(&policySet);
+    }
+    unlockTable(&oldSet);
+    return true;
+}
+
+bool LockManager::getStats(const char* lockId, LockStats* stats) {
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SimLock* simLock = find(lockId);
+    if (simLock != NULL) {
+        *stats = simLock->stats;
+        stats->acquisitions += simLock->fastAcquisitions;
     }
-    return false;
+    unlockTable(&oldSet);
+    return simLock != NULL;
 }
 
-LockManager::LockManager() {}
+// Contention of every lock, destroyed ones included, read without the table
+// mutex.
+void LockManager::getContentionTotals(long* contentions, long long* waitTicks) {
+    *contentions = this->contentions.load(memory_order_relaxed);
+    *waitTicks = this->waitTicks.load(memory_order_relaxed);
+}
+
+LockManager::LockManager() {
+    pthread_mutex_init(&tableMutex, NULL);
+    kernels = bestScanKernels();
+    contentions = 0;
+    waitTicks = 0;
+}
 
 LockManager::~LockManager() {
-    for (map<const char*, pthread_mutex_t*>::iterator iter =
-             singleton->locks.begin();
-         iter != singleton->locks.end(); iter++) {
-        pthread_mutex_destroy(iter->second);
+    for (map<const char*, SimLock*>::iterator iter = locks.begin();
+         iter != locks.end(); iter++) {
         delete iter->second;
-        delete iter->first;
     }
-    LockManager::singleton = NULL;
+    for (vector<SimLock*>::iterator iter = retired.begin();
+         iter != retired.end(); iter++) {
+        delete *iter;
+    }
+    pthread_mutex_destroy(&tableMutex);
 }
 
 LockManager* LockManager::getInstance() {
-    if (!singleton) {
-        singleton = new LockManager();
-    }
-    return singleton;
+    return Simulator::current()->lockManager;
 }
 
+// Threads still waiting for a destroyed lock are woken and fail to get it. The
+// lock itself, and with it its id, is kept until the LockManager goes away
+// since they, or a thread on the fast path, may still be looking at it.
 void LockManager::destroyLock(const char* lockId) {
-    if (locks.count(lockId) == 1) {
-        pthread_mutex_destroy(locks[lockId]);
-        locks.erase(lockId);
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    map<const char*, SimLock*>::iterator found = locks.find(lockId);
+    if (found == locks.end()) {
+        unlockTable(&oldSet);
+        return;
     }
+    SimLock* simLock = found->second;
+    locks.erase(found);
+    simLock->destroyed = true;
+    release(simLock, holderOf(simLock));
+    // No fast path can take or release the lock from here on.
+    simLock->word = CONTENDED;
+    for (set<Thread*>::iterator iter = simLock->readers.begin();
+         iter != simLock->readers.end(); iter++) {
+        release(simLock, *iter);
+    }
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    sigset_t policySet;
+    threadManager->lockPolicy(&policySet);
+    while (threadManager->wakeFrom(&simLock->waiters) != NULL) {
+    }
+    while (threadManager->wakeFrom(&simLock->readWaiters) != NULL) {
+    }
+    threadManager->unlockPolicy(&policySet);
+    retired.push_back(simLock);
+    unlockTable(&oldSet);
 }
 
 bool LockManager::lockExists(const char* lockId) {
-    return locks.count(lockId) == 1;
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    bool ret = locks.count(lockId) == 1;
+    unlockTable(&oldSet);
+    return ret;
 }
 
-bool LockManager::isLocked(const char* lockId) {
-    bool ret = false;
-    if (locks.count(lockId) == 1) {
-        int tryLock = pthread_mutex_trylock(locks[lockId]);
-        ret = tryLock != 0;
-        if (tryLock == 0) {
-            pthread_mutex_unlock(locks[lockId]);
-        }
-    }
+Thread* LockManager::getHolder(const char* lockId) {
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SimLock* simLock = find(lockId);
+    Thread* holder = simLock == NULL ? NULL : holderOf(simLock);
+    unlockTable(&oldSet);
+    return holder;
+}
 
+bool LockManager::isLocked(const char* lockId) {
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SimLock* simLock = find(lockId);
+    bool ret = simLock != NULL && !isFree(simLock);
+    unlockTable(&oldSet);
     return ret;
 }
 
@@ -99,21 +681,69 @@ const char* createLock() {
 }
 
 bool lock(const char* lockId) {
+    SimulatorCall call;
     return LockManager::getInstance()->lock(lockId);
 }
 
 bool unlock(const char* lockId) {
+    SimulatorCall call;
     return LockManager::getInstance()->unlock(lockId);
 }
 
 void destroyLock(const char* lockId) {
+    SimulatorCall call;
     LockManager::getInstance()->destroyLock(lockId);
 }
 
+Thread* getLockHolder(const char* lockId) {
+    SimulatorCall call;
+    return LockManager::getInstance()->getHolder(lockId);
+}
+
+bool tryLock(const char* lockId) {
+    SimulatorCall call;
+    return LockManager::getInstance()->tryLock(lockId);
+}
+
+bool lockWithTimeout(const char* lockId, int ticks) {
+    SimulatorCall call;
+    return LockManager::getInstance()->lockWithTimeout(lockId, ticks);
+}
+
 bool isLocked(const char* lockId) {
+    SimulatorCall call;
     return LockManager::getInstance()->isLocked(lockId);
 }
 
 bool lockExists(const char* lockId) {
+    SimulatorCall call;
     return LockManager::getInstance()->lockExists(lockId);
-}
\ No newline at end of file
+}
+
+const char* createReadWriteLock(bool preferWriters) {
+    return LockManager::getInstance()->createReadWriteLock(preferWriters);
+}
+
+bool lockShared(const char* lockId) {
+    SimulatorCall call;
+    return LockManager::getInstance()->lockShared(lockId);
+}
+
+bool lockExclusive(const char* lockId) {
+    SimulatorCall call;
+    return LockManager::getInstance()->lockExclusive(lockId);
+}
+
+bool unlockShared(const char* lockId) {
+    SimulatorCall call;
+    return LockManager::getInstance()->unlockShared(lockId);
+}
+
+bool unlockExclusive(const char* lockId) {
+    SimulatorCall call;
+    return LockManager::getInstance()->unlockExclusive(lockId);
+}
+
+bool getLockStats(const char* lockId, LockStats* stats) {
+    return LockManager::getInstance()->getStats(lockId, stats);
+}
@@ -2,30 +2,119 @@
 #define FRAMEWORK_LOCKMANAGER_H
 
 #include <pthread.h>
-#include <uuid/uuid.h>
+#include <signal.h>
+#include <atomic>
 #include <map>
+#include <set>
+#include <vector>
 #include "Lock.h"
+#include "ScanKernels.h"
+#include "Stats.h"
+#include "WaitQueue.h"
+#include "structures/Uuid.h"
 
 using namespace std;
+struct Simulator;
 namespace Threading {
 class ThreadManager;
 class LockManager {
     friend class Threading::ThreadManager;
+    friend struct ::Simulator;
 
    private:
-    map<const char*, pthread_mutex_t*> locks;
+    /**
+     * A lock is free, held by a simulated thread, or held by a thread outside
+     * the simulation. Simulated threads that find it held wait in waiters and
+     * are handed the lock in priority order. A plain lock keeps its holder in
+     * word so it can be taken and released without the table mutex; a
+     * reader-writer lock uses held, owner and waiters for exclusive holds, and
+     * keeps its shared holders and the threads waiting to join them apart.
+     */
+    struct SimLock;
+
+    /**
+     * A lock id is the id field of its lock's name, so lock and unlock can get
+     * from the id to the lock without the table mutex. cookie is the address
+     * of the name mixed with NAME_COOKIE, which tells a name from whatever
+     * precedes any other string passed as an id. Names live as long as their
+     * locks, which the LockManager keeps until it goes away.
+     */
+    typedef struct LockName {
+        SimLock* simLock;
+        uintptr_t cookie;
+        char id[UUID_LENGTH];
+    } LockName;
+
+    typedef struct SimLock {
+        atomic<uintptr_t> word;
+        atomic<long> fastAcquisitions;
+        bool held;
+        bool destroyed;
+        Thread* owner;
+        WaitQueue waiters;
+        bool readWrite;
+        bool preferWriters;
+        set<Thread*> readers;
+        int outsideReaders;
+        WaitQueue readWaiters;
+        LockStats stats;
+        LockName name;
+    } SimLock;
+
+    map<const char*, SimLock*> locks;
+    map<Thread*, set<SimLock*>> heldLocks;
+    vector<SimLock*> retired;
+    // Priorities of the first waiters of a thread's locks, for
+    // inheritedPriority.
+    vector<int> donors;
+    const ScanKernels* kernels;
+    atomic<long> contentions;
+    atomic<long long> waitTicks;
+    pthread_mutex_t tableMutex;
     LockManager();
     ~LockManager();
-    static LockManager* singleton;
+    void lockTable(sigset_t* oldSet);
+    void unlockTable(sigset_t* oldSet);
+    const char* create(bool readWrite, bool preferWriters);
+    SimLock* find(const char* lockId);
+    SimLock* named(const char* lockId);
+    void take(SimLock* simLock, Thread* thread);
+    Thread* holderOf(SimLock* simLock);
+    void share(SimLock* simLock, Thread* thread);
+    void release(SimLock* simLock, Thread* thread);
+    bool isFree(SimLock* simLock);
+    bool canShare(SimLock* simLock);
+    void recordAcquisition(SimLock* simLock, bool shared, int waitStart);
+    void raise(Thread* thread, int priority);
+    int donate(Thread* donor, SimLock* simLock, int depth);
+    int inheritedPriority(Thread* thread);
+    void restorePriority(Thread* thread);
+    void handOff(SimLock* simLock);
+    bool lockContended(const char* lockId,
+                       SimLock* simLock,
+                       Thread* currentThread,
+                       int ticks);
+    bool lockReadWrite(const char* lockId, bool shared);
+    bool unlockReadWrite(const char* lockId, bool shared);
 
    public:
     static LockManager* getInstance();
     const char* createLock();
     bool lock(const char* lockId);
+    bool tryLock(const char* lockId);
+    bool lockWithTimeout(const char* lockId, int ticks);
     bool unlock(const char* lockId);
     void destroyLock(const char* lockId);
     bool isLocked(const char* lockId);
+    Thread* getHolder(const char* lockId);
     bool lockExists(const char* lockId);
+    const char* createReadWriteLock(bool preferWriters);
+    bool lockShared(const char* lockId);
+    bool lockExclusive(const char* lockId);
+    bool unlockShared(const char* lockId);
+    bool unlockExclusive(const char* lockId);
+    bool getStats(const char* lockId, LockStats* stats);
+    void getContentionTotals(long* contentions, long long* waitTicks);
 };
 }  // namespace Threading
 
@@ -0,0 +1,210 @@
+#include "ScanKernels.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace Threading;
+
+// The scalar loops take a starting index so the vector kernels can hand them
+// the entries left over after their last whole vector.
+
+static int argmaxFrom(const int* values, int from, int count, int best) {
+    for (int x = from; x < count; x++) {
+        if (best == -1 || values[x] > values[best])
+            best = x;
+    }
+    return best;
+}
+
+static int selectAtMostFrom(const int* values,
+                            const uint8_t* states,
+                            uint8_t wanted,
+                            int from,
+                            int count,
+                            int limit,
+                            int* rows,
+                            int selected) {
+    for (int x = from; x < count; x++) {
+        if (states[x] == wanted && values[x] <= limit)
+            rows[selected++] = x;
+    }
+    return selected;
+}
+
+static int scalarArgmax(const int* values, int count) {
+    return argmaxFrom(values, 0, count, -1);
+}
+
+static int scalarSelectAtMost(const int* values,
+                              const uint8_t* states,
+                              uint8_t wanted,
+                              int count,
+                              int limit,
+                              int* rows) {
+    return selectAtMostFrom(values, states, wanted, 0, count, limit, rows, 0);
+}
+
+static const ScanKernels scalarKernels = {"scalar", scalarArgmax,
+                                          scalarSelectAtMost};
+
+#ifdef SCAN_KERNELS_X86
+
+// The vector kernels are compiled for their instruction set one function at a
+// time, so the rest of the simulator still runs on any x86 CPU.
+
+static int loadStates4(const uint8_t* states) {
+    int packed;
+    memcpy(&packed, states, sizeof(packed));
+    return packed;
+}
+
+#define SSE42 __attribute__((target("sse4.2")))
+#define AVX2 __attribute__((target("avx2")))
+
+SSE42 static int sseArgmax(const int* values, int count) {
+    if (count < 4)
+        return scalarArgmax(values, count);
+    __m128i best = _mm_loadu_si128((const __m128i*)values);
+    int x = 4;
+    for (; x + 4 <= count; x += 4) {
+        __m128i next = _mm_loadu_si128((const __m128i*)(values + x));
+        best = _mm_max_epi32(best, next);
+    }
+    best = _mm_max_epi32(best, _mm_shuffle_epi32(best, 0x4e));
+    best = _mm_max_epi32(best, _mm_shuffle_epi32(best, 0xb1));
+    int max = _mm_cvtsi128_si32(best);
+    for (; x < count; x++) {
+        if (values[x] > max)
+            max = values[x];
+    }
+    // The first occurrence wins, as in the scalar loop.
+    __m128i wanted = _mm_set1_epi32(max);
+    for (x = 0; x + 4 <= count; x += 4) {
+        __m128i next = _mm_loadu_si128((const __m128i*)(values + x));
+        int bits = _mm_movemask_ps(
+            _mm_castsi128_ps(_mm_cmpeq_epi32(next, wanted)));
+        if (bits != 0)
+            return x + __builtin_ctz(bits);
+    }
+    return argmaxFrom(values, x, count, -1);
+}
+
+SSE42 static int sseSelectAtMost(const int* values,
+                                 const uint8_t* states,
+                                 uint8_t wanted,
+                                 int count,
+                                 int limit,
+                                 int* rows) {
+    __m128i wantedStates = _mm_set1_epi32(wanted);
+    __m128i limits = _mm_set1_epi32(limit);
+    int selected = 0;
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i state =
+            _mm_cvtepu8_epi32(_mm_cvtsi32_si128(loadStates4(states + x)));
+        __m128i value = _mm_loadu_si128((const __m128i*)(values + x));
+        __m128i match = _mm_andnot_si128(_mm_cmpgt_epi32(value, limits),
+                                         _mm_cmpeq_epi32(state, wantedStates));
+        int bits = _mm_movemask_ps(_mm_castsi128_ps(match));
+        while (bits != 0) {
+            rows[selected++] = x + __builtin_ctz(bits);
+            bits &= bits - 1;
+        }
+    }
+    return selectAtMostFrom(values, states, wanted, x, count, limit, rows,
+                            selected);
+}
+
+static const ScanKernels sseKernels = {"sse4.2", sseArgmax, sseSelectAtMost};
+
+AVX2 static int avxArgmax(const int* values, int count) {
+    if (count < 8)
+        return scalarArgmax(values, count);
+    __m256i best = _mm256_loadu_si256((const __m256i*)values);
+    int x = 8;
+    for (; x + 8 <= count; x += 8) {
+        __m256i next = _mm256_loadu_si256((const __m256i*)(values + x));
+        best = _mm256_max_epi32(best, next);
+    }
+    __m128i half = _mm_max_epi32(_mm256_castsi256_si128(best),
+                                 _mm256_extracti128_si256(best, 1));
+    half = _mm_max_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+    half = _mm_max_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+    int max = _mm_cvtsi128_si32(half);
+    for (; x < count; x++) {
+        if (values[x] > max)
+            max = values[x];
+    }
+    __m256i wanted = _mm256_set1_epi32(max);
+    for (x = 0; x + 8 <= count; x += 8) {
+        __m256i next = _mm256_loadu_si256((const __m256i*)(values + x));
+        int bits = _mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(next, wanted)));
+        if (bits != 0)
+            return x + __builtin_ctz(bits);
+    }
+    return argmaxFrom(values, x, count, -1);
+}
+
+AVX2 static int avxSelectAtMost(const int* values,
+                                const uint8_t* states,
+                                uint8_t wanted,
+                                int count,
+                                int limit,
+                                int* rows) {
+    __m256i wantedStates = _mm256_set1_epi32(wanted);
+    __m256i limits = _mm256_set1_epi32(limit);
+    int selected = 0;
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        __m256i state = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64((const __m128i*)(states + x)));
+        __m256i value = _mm256_loadu_si256((const __m256i*)(values + x));
+        __m256i match =
+            _mm256_andnot_si256(_mm256_cmpgt_epi32(value, limits),
+                                _mm256_cmpeq_epi32(state, wantedStates));
+        int bits = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+        while (bits != 0) {
+            rows[selected++] = x + __builtin_ctz(bits);
+            bits &= bits - 1;
+        }
+    }
+    return selectAtMostFrom(values, states, wanted, x, count, limit, rows,
+                            selected);
+}
+
+static const ScanKernels avxKernels = {"avx2", avxArgmax, avxSelectAtMost};
+
+#endif  // SCAN_KERNELS_X86
+
+const ScanKernels* Threading::scalarScanKernels() {
+    return &scalarKernels;
+}
+
+int Threading::supportedScanKernels(const ScanKernels** kernels) {
+    int found = 0;
+    kernels[found++] = &scalarKernels;
+#ifdef SCAN_KERNELS_X86
+    if (__builtin_cpu_supports("sse4.2"))
+        kernels[found++] = &sseKernels;
+    if (__builtin_cpu_supports("avx2"))
+        kernels[found++] = &avxKernels;
+#endif
+    return found;
+}
+
+const ScanKernels* Threading::bestScanKernels() {
+#ifdef SCAN_KERNELS_X86
+    static const ScanKernels* best =
+        __builtin_cpu_supports("avx2")
+            ? &avxKernels
+            : __builtin_cpu_supports("sse4.2") ? &sseKernels : &scalarKernels;
+    return best;
+#else
+    return &scalarKernels;
+#endif
+}
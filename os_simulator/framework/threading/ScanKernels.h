@@ -0,0 +1,51 @@
+#ifndef OS_THREADING_SCANKERNELS_H
+#define OS_THREADING_SCANKERNELS_H
+
+#include <stdint.h>
+
+namespace Threading {
+
+/**
+ * Loops over the columns of a ThreadTable. Every implementation gives the
+ * same results; the vectorized ones are picked at run time when the CPU
+ * supports them.
+ *
+ * argmax returns the first index of the largest of count values, -1 if count
+ * is 0.
+ *
+ * selectAtMost writes the indexes, in order, of the entries whose state is
+ * wanted and whose value is at most limit to rows, and returns how many it
+ * wrote. rows must have room for count indexes.
+ */
+typedef struct ScanKernels {
+    const char* name;
+    int (*argmax)(const int* values, int count);
+    int (*selectAtMost)(const int* values,
+                        const uint8_t* states,
+                        uint8_t wanted,
+                        int count,
+                        int limit,
+                        int* rows);
+} ScanKernels;
+
+/**
+ * The plain loops, always available.
+ */
+const ScanKernels* scalarScanKernels();
+
+/**
+ * The fastest kernels this CPU supports: AVX2, then SSE4.2, then the plain
+ * loops.
+ */
+const ScanKernels* bestScanKernels();
+
+/**
+ * Writes every set of kernels this CPU supports, the plain loops first, to
+ * kernels and returns how many it wrote. kernels must have room for
+ * SCAN_KERNEL_SETS entries.
+ */
+const int SCAN_KERNEL_SETS = 3;
+int supportedScanKernels(const ScanKernels** kernels);
+}  // namespace Threading
+
+#endif  // OS_THREADING_SCANKERNELS_H
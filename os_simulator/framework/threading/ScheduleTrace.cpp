@@ -0,0 +1,111 @@
+#include "ScheduleTrace.h"
+#include <stdlib.h>
+#include <string.h>
+#include "Replay.h"
+#include "SimulatorContext.h"
+#include "io/InternalLogger.h"
+
+using namespace Threading;
+
+static const char TRACE_MAGIC[4] = {'O', 'S', 'S', 'T'};
+static const uint32_t TRACE_VERSION = 2;
+
+
+ScheduleTrace::ScheduleTrace(Mode mode, FILE* file) {
+    this->mode = mode;
+    this->file = file;
+}
+
+ScheduleTrace::~ScheduleTrace() {
+    fclose(file);
+}
+
+// The setting waits in the simulator bound to the calling thread.
+void ScheduleTrace::configure(Mode mode, const char* path) {
+    Simulator* simulator = Simulator::current();
+    free(simulator->tracePath);
+    simulator->tracePath = path != NULL ? strdup(path) : NULL;
+    simulator->traceMode = path != NULL ? mode : TRACE_OFF;
+}
+
+ScheduleTrace* ScheduleTrace::openConfigured() {
+    Simulator* simulator = Simulator::current();
+    if (simulator->traceMode == TRACE_OFF) {
+        // Lets existing binaries (e.g. a single gtest case) be recorded and
+        // replayed without changes.
+        if (getenv("SIMULATOR_REPLAY") != NULL) {
+            configure(TRACE_REPLAY, getenv("SIMULATOR_REPLAY"));
+        } else if (getenv("SIMULATOR_RECORD") != NULL) {
+            configure(TRACE_RECORD, getenv("SIMULATOR_RECORD"));
+        } else {
+            return NULL;
+        }
+    }
+    Mode mode = simulator->traceMode;
+    char* path = simulator->tracePath;
+    simulator->traceMode = TRACE_OFF;
+    simulator->tracePath = NULL;
+
+    FILE* file = fopen(path, mode == TRACE_RECORD ? "wb" : "rb");
+    if (file == NULL) {
+        InternalLogger::eventSink() << "[ScheduleTrace] Cannot open " << path
+                                    << "; scheduling will not be traced\n";
+        InternalLogger::getLogger().flush();
+        free(path);
+        return NULL;
+    }
+    if (mode == TRACE_RECORD) {
+        fwrite(TRACE_MAGIC, sizeof(TRACE_MAGIC), 1, file);
+        fwrite(&TRACE_VERSION, sizeof(TRACE_VERSION), 1, file);
+    } else {
+        char magic[sizeof(TRACE_MAGIC)];
+        uint32_t version = 0;
+        if (fread(magic, sizeof(magic), 1, file) != 1 ||
+            memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+            fread(&version, sizeof(version), 1, file) != 1 ||
+            version != TRACE_VERSION) {
+            InternalLogger::eventSink()
+                << "[ScheduleTrace] " << path
+                << " is not a schedule trace; it will not be replayed\n";
+            InternalLogger::getLogger().flush();
+            fclose(file);
+            free(path);
+            return NULL;
+        }
+    }
+    free(path);
+    return new ScheduleTrace(mode, file);
+}
+
+ScheduleTrace::Mode ScheduleTrace::getMode() {
+    return mode;
+}
+
+void ScheduleTrace::write(int tick, int thread, TraceEvent event, int count) {
+    int32_t fields[3] = {tick, thread, count};
+    uint8_t eventByte = (uint8_t)event;
+    fwrite(fields, sizeof(fields), 1, file);
+    fwrite(&eventByte, sizeof(eventByte), 1, file);
+}
+
+bool ScheduleTrace::read(TraceRecord* record) {
+    int32_t fields[3];
+    uint8_t eventByte;
+    if (fread(fields, sizeof(fields), 1, file) != 1 ||
+        fread(&eventByte, sizeof(eventByte), 1, file) != 1) {
+        return false;
+    }
+    record->tick = fields[0];
+    record->thread = fields[1];
+    record->count = fields[2];
+    record->event = eventByte;
+    return true;
+}
+
+void recordSchedule(const char* path) {
+    ScheduleTrace::configure(ScheduleTrace::TRACE_RECORD, path);
+}
+
+void replaySchedule(const char* path) {
+    ScheduleTrace::configure(ScheduleTrace::TRACE_REPLAY, path);
+}
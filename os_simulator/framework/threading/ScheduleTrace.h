@@ -0,0 +1,62 @@
+#ifndef OS_THREADING_SCHEDULETRACE_H
+#define OS_THREADING_SCHEDULETRACE_H
+
+#include <stdint.h>
+#include <cstdio>
+
+namespace Threading {
+
+/**
+ * What happened to a tick. Every tick has either an IDLE record or a DISPATCH
+ * record followed by one of YIELD, PREEMPT or EXIT for the same thread.
+ */
+typedef enum TraceEvent {
+    TRACE_IDLE = 0,
+    TRACE_DISPATCH = 1,
+    TRACE_YIELD = 2,
+    TRACE_PREEMPT = 3,
+    TRACE_EXIT = 4
+} TraceEvent;
+
+/**
+ * One record of a trace. count is, for the record of a tick's decision, how
+ * many created threads had been handed to the scheduler by then, and for the
+ * record that ends a slice, how many calls into the simulator the thread made
+ * during it.
+ */
+typedef struct TraceRecord {
+    int32_t tick;
+    int32_t thread;
+    int32_t count;
+    uint8_t event;
+} TraceRecord;
+
+/**
+ * A binary log of scheduling decisions. Threads are identified by their
+ * slot, which a run of the same workload hands out in the same order, so a
+ * recording can be matched against another run of it. The counts in the
+ * records let a replay hand threads to the scheduler on the same ticks and
+ * end a preempted slice after the same call.
+ *
+ * File layout: the 4 byte magic "OSST", a 4 byte version, then 13 byte
+ * records (tick, thread, count, event) in host byte order.
+ */
+class ScheduleTrace {
+   public:
+    typedef enum Mode { TRACE_OFF, TRACE_RECORD, TRACE_REPLAY } Mode;
+
+    static void configure(Mode mode, const char* path);
+    static ScheduleTrace* openConfigured();
+    ~ScheduleTrace();
+    Mode getMode();
+    void write(int tick, int thread, TraceEvent event, int count);
+    bool read(TraceRecord* record);
+
+   private:
+    ScheduleTrace(Mode mode, FILE* file);
+    Mode mode;
+    FILE* file;
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_SCHEDULETRACE_H
@@ -0,0 +1,132 @@
+#include "SimulatorContext.h"
+
+#include <string.h>
+#include <cstdlib>
+#include "LockManager.h"
+#include "SyncManager.h"
+#include "ThreadArena.h"
+#include "ThreadManager.h"
+#include "io/InternalLogger.h"
+#include "scheduling/FairSharePolicy.h"
+#include "scheduling/MlfqPolicy.h"
+#include "scheduling/PriorityRoundRobinPolicy.h"
+#include "structures/ListManager.h"
+
+using namespace Threading;
+
+thread_local Simulator* Simulator::bound = NULL;
+atomic<Simulator*> Simulator::callbackHolder(NULL);
+static pthread_mutex_t callbackMutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic<long> lastSerial(0);
+
+Simulator::Simulator() : serial(++lastSerial) {
+    threadManager = NULL;
+    lockManager = new LockManager();
+    syncManager = new SyncManager();
+    arena = new ThreadArena();
+    lists = new ListManager();
+    logger = new InternalLogger();
+    memset(&finalStats, 0, sizeof(finalStats));
+    memset(&finalTiming, 0, sizeof(finalTiming));
+    overrunWarningNanos = 0;
+    heldOut = false;
+    timeSliceConfig = PriorityRoundRobinPolicy::DEFAULT_CONFIG;
+    fairShareConfig = FairSharePolicy::DEFAULT_CONFIG;
+    mlfqConfig = MlfqPolicy::DEFAULT_CONFIG;
+    pthread_mutex_init(&policyStatsMutex, NULL);
+    memset(&fairShareStats, 0, sizeof(fairShareStats));
+    memset(&mlfqStats, 0, sizeof(mlfqStats));
+    memset(&realtimeStats, 0, sizeof(realtimeStats));
+    traceMode = ScheduleTrace::TRACE_OFF;
+    tracePath = NULL;
+    statsPageName = NULL;
+    pthread_mutex_init(&mapsMutex, NULL);
+}
+
+Simulator::~Simulator() {
+    delete threadManager;
+    delete syncManager;
+    delete lockManager;
+    for (map<const void*, Structures*>::iterator iter = maps.begin();
+         iter != maps.end(); iter++) {
+        delete iter->second;
+    }
+    delete lists;
+    delete arena;
+    delete logger;
+    pthread_mutex_destroy(&policyStatsMutex);
+    pthread_mutex_destroy(&mapsMutex);
+    free(tracePath);
+    free(statsPageName);
+}
+
+Simulator* Simulator::current() {
+    if (bound != NULL)
+        return bound;
+    // Created on first use, as the singletons it stands in for were.
+    static Simulator* defaultSimulator = new Simulator();
+    return defaultSimulator;
+}
+
+void Simulator::bind(Simulator* simulator) {
+    bound = simulator;
+}
+
+// Called by startSystem. The callbacks are set up for this simulator unless
+// another one holds them, in which case they stay out of its way until
+// stopSystem.
+bool Simulator::claimCallbacks() {
+    pthread_mutex_lock(&callbackMutex);
+    if (callbackHolder == NULL) {
+        callbackHolder = this;
+        initializeCallback();
+    }
+    heldOut = callbackHolder != this;
+    pthread_mutex_unlock(&callbackMutex);
+    return !heldOut;
+}
+
+void Simulator::releaseCallbacks() {
+    pthread_mutex_lock(&callbackMutex);
+    if (callbackHolder == this) {
+        shutdownCallback();
+        callbackHolder = NULL;
+    }
+    heldOut = false;
+    pthread_mutex_unlock(&callbackMutex);
+}
+
+// A simulator that is not running reaches the callbacks while no one holds
+// them, so locks can still be used before startSystem.
+bool Simulator::reachesCallbacks() {
+    Simulator* holder = callbackHolder;
+    return holder == this || (holder == NULL && !heldOut);
+}
+
+Structures* Simulator::mapManager(const void* key, Structures* (*create)()) {
+    pthread_mutex_lock(&mapsMutex);
+    map<const void*, Structures*>::iterator found = maps.find(key);
+    if (found == maps.end())
+        found = maps.insert(make_pair(key, create())).first;
+    Structures* structures = found->second;
+    pthread_mutex_unlock(&mapsMutex);
+    return structures;
+}
+
+Simulator* createSimulator() {
+    return new Simulator();
+}
+
+void destroySimulator(Simulator* simulator) {
+    if (Simulator::current() == simulator)
+        Simulator::bind(NULL);
+    delete simulator;
+}
+
+void setCurrentSimulator(Simulator* simulator) {
+    Simulator::bind(simulator);
+}
+
+Simulator* getCurrentSimulator() {
+    return Simulator::current();
+}
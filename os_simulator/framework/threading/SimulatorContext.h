@@ -0,0 +1,83 @@
+#ifndef OS_THREADING_SIMULATORCONTEXT_H
+#define OS_THREADING_SIMULATORCONTEXT_H
+
+#include <pthread.h>
+#include <atomic>
+#include <map>
+#include "ScheduleTrace.h"
+#include "Scheduler.h"
+#include "Simulator.h"
+#include "Stats.h"
+
+using namespace std;
+
+class InternalLogger;
+class ListManager;
+class Structures;
+namespace Threading {
+class ThreadManager;
+class LockManager;
+class SyncManager;
+class ThreadArena;
+}  // namespace Threading
+
+/**
+ * Everything one simulation runs on. The getInstance of each manager returns
+ * the one of the simulator bound to the calling thread, so the framework is
+ * written as if there were only one. Threads the simulator starts are bound
+ * to it; any other thread uses the default simulator until it binds one.
+ *
+ * The ThreadManager lives from startSystem to stopSystem and leaves its
+ * counters behind in finalStats and finalTiming; its policies leave theirs in
+ * the policy counters, which policyStatsMutex guards. The tunables and the
+ * trace and stats page settings wait here for the next startSystem.
+ * Everything else lives as long as the simulator.
+ *
+ * The callbacks in Thread.student.h and Lock.student.h keep their state in
+ * globals, so only one simulator at a time holds them. It is the one that
+ * calls initializeCallback and shutdownCallback and the only one whose locks
+ * reach the lock callbacks while it runs.
+ */
+struct Simulator {
+   public:
+    Simulator();
+    ~Simulator();
+    static Simulator* current();
+    static void bind(Simulator* simulator);
+    bool claimCallbacks();
+    void releaseCallbacks();
+    bool reachesCallbacks();
+    Structures* mapManager(const void* key, Structures* (*create)());
+    const long serial;
+    Threading::ThreadManager* threadManager;
+    Threading::LockManager* lockManager;
+    Threading::SyncManager* syncManager;
+    Threading::ThreadArena* arena;
+    ListManager* lists;
+    InternalLogger* logger;
+    SchedulerStats finalStats;
+    TickTimingStats finalTiming;
+    atomic<long long> overrunWarningNanos;
+    TimeSliceConfig timeSliceConfig;
+    FairShareConfig fairShareConfig;
+    MlfqConfig mlfqConfig;
+    pthread_mutex_t policyStatsMutex;
+    FairShareStats fairShareStats;
+    MlfqStats mlfqStats;
+    RealtimeStats realtimeStats;
+    map<Thread*, RealtimeThreadStats> realtimeThreadStats;
+    Threading::ScheduleTrace::Mode traceMode;
+    char* tracePath;
+    char* statsPageName;
+
+   private:
+    static thread_local Simulator* bound;
+    static atomic<Simulator*> callbackHolder;
+    // Set while this simulator runs without the callbacks.
+    atomic<bool> heldOut;
+    // One MapManager per key type, keyed by an address unique to the type.
+    map<const void*, Structures*> maps;
+    pthread_mutex_t mapsMutex;
+};
+
+#endif  // OS_THREADING_SIMULATORCONTEXT_H
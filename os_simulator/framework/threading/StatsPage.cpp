@@ -0,0 +1,60 @@
+#include "StatsPublisher.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace Threading;
+
+// The reading side of the stats page, kept apart from StatsPublisher so that
+// readers such as the monitor link without the rest of the simulator.
+
+const char Threading::STATS_PAGE_MAGIC[8] = "OSSTATS";
+static const char* STATS_PAGE_DIRECTORY = "/dev/shm/";
+
+string Threading::statsPagePath(const char* name) {
+    return string(STATS_PAGE_DIRECTORY) + name;
+}
+
+const StatsPage* mapStatsPage(const char* name) {
+    int fd = open(statsPagePath(name).c_str(), O_RDONLY);
+    if (fd == -1)
+        return NULL;
+    void* mapped = MAP_FAILED;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(StatsPage)) {
+        mapped = mmap(NULL, sizeof(StatsPage), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return NULL;
+    const StatsPage* page = (const StatsPage*)mapped;
+    if (memcmp(page->magic, STATS_PAGE_MAGIC, sizeof(page->magic)) != 0 ||
+        page->version != STATS_PAGE_VERSION) {
+        munmap(mapped, sizeof(StatsPage));
+        return NULL;
+    }
+    return page;
+}
+
+void readStatsPage(const StatsPage* page, StatsPageCounters* counters) {
+    while (true) {
+        uint32_t before = page->sequence.load(memory_order_acquire);
+        if ((before & 1) == 0) {
+            memcpy(counters, &page->counters, sizeof(*counters));
+            atomic_thread_fence(memory_order_acquire);
+            if (page->sequence.load(memory_order_relaxed) == before)
+                return;
+        }
+        sched_yield();
+    }
+}
+
+void unmapStatsPage(const StatsPage* page) {
+    if (page != NULL)
+        munmap((void*)page, sizeof(StatsPage));
+}
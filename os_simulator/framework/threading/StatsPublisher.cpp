@@ -0,0 +1,116 @@
+#include "StatsPublisher.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include "SimulatorContext.h"
+#include "io/InternalLogger.h"
+
+using namespace std;
+using namespace Threading;
+
+static const long long NANOS_PER_SECOND = 1000000000LL;
+
+static long long monotonicNanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOS_PER_SECOND + now.tv_nsec;
+}
+
+StatsPublisher::StatsPublisher(StatsPage* page) {
+    this->page = page;
+    memset(&last, 0, sizeof(last));
+    windowStart = monotonicNanos();
+    windowTick = 0;
+    ticksPerSecond = 0;
+}
+
+// The page keeps the last counters, marked as no longer running.
+StatsPublisher::~StatsPublisher() {
+    last.running = 0;
+    write(&last);
+    munmap(page, sizeof(StatsPage));
+}
+
+// The name waits in the simulator bound to the calling thread.
+void StatsPublisher::configure(const char* name) {
+    Simulator* simulator = Simulator::current();
+    free(simulator->statsPageName);
+    simulator->statsPageName = name != NULL ? strdup(name) : NULL;
+}
+
+StatsPublisher* StatsPublisher::openConfigured() {
+    Simulator* simulator = Simulator::current();
+    if (simulator->statsPageName == NULL) {
+        if (getenv("SIMULATOR_STATS") == NULL)
+            return NULL;
+        configure(getenv("SIMULATOR_STATS"));
+    }
+    string path = statsPagePath(simulator->statsPageName);
+    free(simulator->statsPageName);
+    simulator->statsPageName = NULL;
+
+    // A reader still mapping the page of the last run sees this one's
+    // counters from the start.
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    void* mapped = MAP_FAILED;
+    if (fd != -1 && ftruncate(fd, sizeof(StatsPage)) == 0) {
+        mapped = mmap(NULL, sizeof(StatsPage), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    }
+    if (fd != -1)
+        close(fd);
+    if (mapped == MAP_FAILED) {
+        InternalLogger::eventSink() << "[StatsPublisher] Cannot map " << path
+                                    << "; stats will not be published\n";
+        InternalLogger::getLogger().flush();
+        return NULL;
+    }
+    // The sequence is odd, as a crashed writer may also have left it, until
+    // the page is set up.
+    StatsPage* page = (StatsPage*)mapped;
+    uint32_t sequence = page->sequence.load(memory_order_relaxed) | 1;
+    page->sequence.store(sequence, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(page->magic, STATS_PAGE_MAGIC, sizeof(page->magic));
+    page->version = STATS_PAGE_VERSION;
+    memset(&page->counters, 0, sizeof(page->counters));
+    page->sequence.store(sequence + 1, memory_order_release);
+    return new StatsPublisher(page);
+}
+
+// Fills in the tick rate, which is measured here so it costs nothing when
+// stats are not published.
+void StatsPublisher::publish(StatsPageCounters* counters) {
+    long long now = monotonicNanos();
+    long long elapsed = now - windowStart;
+    double rate = elapsed > 0 ? (double)(counters->tick - windowTick) *
+                                    NANOS_PER_SECOND / elapsed
+                              : 0;
+    if (elapsed >= NANOS_PER_SECOND) {
+        ticksPerSecond = rate;
+        windowStart = now;
+        windowTick = counters->tick;
+    }
+    // Until a whole second has gone by the rate so far is all there is.
+    counters->ticksPerSecond = ticksPerSecond > 0 ? ticksPerSecond : rate;
+    counters->running = 1;
+    last = *counters;
+    write(counters);
+}
+
+void StatsPublisher::write(const StatsPageCounters* counters) {
+    uint32_t sequence = page->sequence.load(memory_order_relaxed);
+    page->sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&page->counters, counters, sizeof(page->counters));
+    page->sequence.store(sequence + 2, memory_order_release);
+}
+
+void publishStats(const char* name) {
+    StatsPublisher::configure(name);
+}
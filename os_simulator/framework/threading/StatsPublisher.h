@@ -0,0 +1,37 @@
+#ifndef OS_THREADING_STATSPUBLISHER_H
+#define OS_THREADING_STATSPUBLISHER_H
+
+#include <string>
+#include "StatsPage.h"
+
+namespace Threading {
+
+extern const char STATS_PAGE_MAGIC[8];
+
+// The file a page published under name is mapped from.
+std::string statsPagePath(const char* name);
+
+/**
+ * Writes the counters of a run to a StatsPage mapped from a file in /dev/shm.
+ * Only the idle thread publishes, so the sequence needs no compare-and-swap;
+ * readers copy the counters out and check the sequence did not move.
+ */
+class StatsPublisher {
+   public:
+    static void configure(const char* name);
+    static StatsPublisher* openConfigured();
+    ~StatsPublisher();
+    void publish(StatsPageCounters* counters);
+
+   private:
+    StatsPublisher(StatsPage* page);
+    void write(const StatsPageCounters* counters);
+    StatsPage* page;
+    StatsPageCounters last;
+    long long windowStart;
+    int windowTick;
+    double ticksPerSecond;
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_STATSPUBLISHER_H
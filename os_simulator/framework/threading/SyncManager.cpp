@@ -0,0 +1,259 @@
+#include "SyncManager.h"
+#include <unistd.h>
+#include "SimulatorContext.h"
+#include "ThreadManager.h"
+#include "structures/Uuid.h"
+
+using namespace Threading;
+
+SyncManager::SyncManager() {
+    pthread_mutex_init(&tableMutex, NULL);
+}
+
+SyncManager::~SyncManager() {
+    for (map<const char*, SyncObject*>::iterator iter = objects.begin();
+         iter != objects.end(); iter++) {
+        delete iter->second;
+        delete[] iter->first;
+    }
+    for (vector<SyncObject*>::iterator iter = retired.begin();
+         iter != retired.end(); iter++) {
+        delete *iter;
+    }
+    pthread_mutex_destroy(&tableMutex);
+}
+
+SyncManager* SyncManager::getInstance() {
+    return Simulator::current()->syncManager;
+}
+
+// Same rule as the lock table: no pauses while the mutex is held.
+void SyncManager::lockTable(sigset_t* oldSet) {
+    sigset_t sigSet;
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &sigSet, oldSet);
+    pthread_mutex_lock(&tableMutex);
+}
+
+void SyncManager::unlockTable(sigset_t* oldSet) {
+    pthread_mutex_unlock(&tableMutex);
+    pthread_sigmask(SIG_SETMASK, oldSet, NULL);
+}
+
+const char* SyncManager::create(bool isSemaphore, int value) {
+    char* id = createUuid();
+    SyncObject* object = new SyncObject();
+    object->isSemaphore = isSemaphore;
+    object->destroyed = false;
+    object->value = value < 0 ? 0 : value;
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    objects[id] = object;
+    unlockTable(&oldSet);
+    return id;
+}
+
+// Expects the table mutex to be held.
+SyncManager::SyncObject* SyncManager::find(const char* id, bool isSemaphore) {
+    map<const char*, SyncObject*>::iterator found = objects.find(id);
+    if (found == objects.end() || found->second->isSemaphore != isSemaphore)
+        return NULL;
+    return found->second;
+}
+
+// Expects the table mutex to be held. A semaphore's unit goes to the thread
+// that is woken, except when the semaphore is being destroyed.
+void SyncManager::wake(SyncObject* object, bool all) {
+    if (object->waiters.empty())
+        return;
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    sigset_t policySet;
+    threadManager->lockPolicy(&policySet);
+    Thread* waiter;
+    while ((waiter = threadManager->wakeFrom(&object->waiters)) != NULL) {
+        if (object->isSemaphore && !object->destroyed)
+            object->granted.insert(waiter);
+        if (!all)
+            break;
+    }
+    threadManager->unlockPolicy(&policySet);
+}
+
+// Waiters may still be looking at a destroyed object, so it is only freed
+// with the SyncManager unless nobody waits for it.
+void SyncManager::destroy(const char* id, bool isSemaphore) {
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    map<const char*, SyncObject*>::iterator found = objects.find(id);
+    if (found == objects.end() || found->second->isSemaphore != isSemaphore) {
+        unlockTable(&oldSet);
+        return;
+    }
+    SyncObject* object = found->second;
+    const char* key = found->first;
+    objects.erase(found);
+    delete[] key;
+    if (object->waiters.empty() && object->granted.empty()) {
+        delete object;
+    } else {
+        object->destroyed = true;
+        wake(object, true);
+        retired.push_back(object);
+    }
+    unlockTable(&oldSet);
+}
+
+const char* SyncManager::createCondition() {
+    return create(false, 0);
+}
+
+bool SyncManager::waitCondition(const char* conditionId, const char* lockId) {
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    Thread* currentThread =
+        threadManager->currentThread()->getExternalThread();
+    // Only the holder may give the lock up to wait.
+    if (currentThread == NULL ||
+        LockManager::getInstance()->getHolder(lockId) != currentThread)
+        return false;
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SyncObject* condition = find(conditionId, false);
+    if (condition == NULL) {
+        unlockTable(&oldSet);
+        return false;
+    }
+    // Queue up before letting go of the lock so a signal sent as soon as the
+    // lock is free still finds this thread.
+    sigset_t policySet;
+    threadManager->lockPolicy(&policySet);
+    threadManager->blockOn(&condition->waiters);
+    threadManager->unlockPolicy(&policySet);
+    unlockTable(&oldSet);
+    unlock(lockId);
+    threadManager->parkCurrentThread();
+    return lock(lockId);
+}
+
+bool SyncManager::signalCondition(const char* conditionId, bool all) {
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SyncObject* condition = find(conditionId, false);
+    if (condition != NULL)
+        wake(condition, all);
+    unlockTable(&oldSet);
+    return condition != NULL;
+}
+
+void SyncManager::destroyCondition(const char* conditionId) {
+    destroy(conditionId, false);
+}
+
+const char* SyncManager::createSemaphore(int value) {
+    return create(true, value);
+}
+
+bool SyncManager::semaphoreWait(const char* semaphoreId) {
+    ThreadManager* threadManager = ThreadManager::getInstance();
+    Thread* currentThread =
+        threadManager->currentThread()->getExternalThread();
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SyncObject* semaphore = find(semaphoreId, true);
+    if (semaphore == NULL) {
+        unlockTable(&oldSet);
+        return false;
+    }
+    // Threads outside the simulation cannot be put to sleep by the
+    // scheduler, so they check back every tick.
+    while (currentThread == NULL && semaphore->value == 0 &&
+           !semaphore->destroyed) {
+        unlockTable(&oldSet);
+        usleep(MICROSECONDS_TICK);
+        lockTable(&oldSet);
+    }
+    if (semaphore->destroyed) {
+        unlockTable(&oldSet);
+        return false;
+    }
+    if (semaphore->value > 0) {
+        semaphore->value--;
+        unlockTable(&oldSet);
+        return true;
+    }
+
+    sigset_t policySet;
+    threadManager->lockPolicy(&policySet);
+    threadManager->blockOn(&semaphore->waiters);
+    threadManager->unlockPolicy(&policySet);
+    unlockTable(&oldSet);
+    threadManager->parkCurrentThread();
+
+    // semaphorePost hands its unit straight to the thread it wakes.
+    lockTable(&oldSet);
+    bool taken = semaphore->granted.erase(currentThread) == 1;
+    unlockTable(&oldSet);
+    return taken;
+}
+
+bool SyncManager::semaphorePost(const char* semaphoreId) {
+    sigset_t oldSet;
+    lockTable(&oldSet);
+    SyncObject* semaphore = find(semaphoreId, true);
+    if (semaphore != NULL) {
+        if (semaphore->waiters.empty()) {
+            semaphore->value++;
+        } else {
+            wake(semaphore, false);
+        }
+    }
+    unlockTable(&oldSet);
+    return semaphore != NULL;
+}
+
+void SyncManager::destroySemaphore(const char* semaphoreId) {
+    destroy(semaphoreId, true);
+}
+
+const char* createCondition() {
+    return SyncManager::getInstance()->createCondition();
+}
+
+bool waitCondition(const char* conditionId, const char* lockId) {
+    SimulatorCall call;
+    return SyncManager::getInstance()->waitCondition(conditionId, lockId);
+}
+
+bool signalCondition(const char* conditionId) {
+    SimulatorCall call;
+    return SyncManager::getInstance()->signalCondition(conditionId, false);
+}
+
+bool broadcastCondition(const char* conditionId) {
+    SimulatorCall call;
+    return SyncManager::getInstance()->signalCondition(conditionId, true);
+}
+
+void destroyCondition(const char* conditionId) {
+    SimulatorCall call;
+    SyncManager::getInstance()->destroyCondition(conditionId);
+}
+
+const char* createSemaphore(int value) {
+    return SyncManager::getInstance()->createSemaphore(value);
+}
+
+bool semaphoreWait(const char* semaphoreId) {
+    SimulatorCall call;
+    return SyncManager::getInstance()->semaphoreWait(semaphoreId);
+}
+
+bool semaphorePost(const char* semaphoreId) {
+    SimulatorCall call;
+    return SyncManager::getInstance()->semaphorePost(semaphoreId);
+}
+
+void destroySemaphore(const char* semaphoreId) {
+    SimulatorCall call;
+    SyncManager::getInstance()->destroySemaphore(semaphoreId);
+}
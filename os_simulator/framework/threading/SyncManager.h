@@ -0,0 +1,57 @@
+#ifndef FRAMEWORK_SYNCMANAGER_H
+#define FRAMEWORK_SYNCMANAGER_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "Sync.h"
+#include "WaitQueue.h"
+
+using namespace std;
+struct Simulator;
+namespace Threading {
+
+/**
+ * Keeps the condition variables and semaphores. Both are a wait queue plus a
+ * count that only semaphores use.
+ */
+class SyncManager {
+    friend struct ::Simulator;
+
+   private:
+    typedef struct SyncObject {
+        bool isSemaphore;
+        bool destroyed;
+        int value;
+        WaitQueue waiters;
+        set<Thread*> granted;
+    } SyncObject;
+
+    map<const char*, SyncObject*> objects;
+    vector<SyncObject*> retired;
+    pthread_mutex_t tableMutex;
+    SyncManager();
+    ~SyncManager();
+    void lockTable(sigset_t* oldSet);
+    void unlockTable(sigset_t* oldSet);
+    const char* create(bool isSemaphore, int value);
+    SyncObject* find(const char* id, bool isSemaphore);
+    void wake(SyncObject* object, bool all);
+    void destroy(const char* id, bool isSemaphore);
+
+   public:
+    static SyncManager* getInstance();
+    const char* createCondition();
+    bool waitCondition(const char* conditionId, const char* lockId);
+    bool signalCondition(const char* conditionId, bool all);
+    void destroyCondition(const char* conditionId);
+    const char* createSemaphore(int value);
+    bool semaphoreWait(const char* semaphoreId);
+    bool semaphorePost(const char* semaphoreId);
+    void destroySemaphore(const char* semaphoreId);
+};
+}  // namespace Threading
+
+#endif  // FRAMEWORK_SYNCMANAGER_H
@@ -0,0 +1,97 @@
+#include "ThreadArena.h"
+
+#include <cstring>
+#include "SimulatorContext.h"
+#include "ThreadManager.h"
+
+using namespace Threading;
+
+ThreadArena::ThreadArena() {
+    pthread_mutex_init(&arenaMutex, NULL);
+    freeRecords = NULL;
+}
+
+ThreadArena::~ThreadArena() {
+    for (vector<Record*>::iterator slab = slabs.begin(); slab != slabs.end();
+         slab++) {
+        delete[] *slab;
+    }
+    pthread_mutex_destroy(&arenaMutex);
+}
+
+ThreadArena* ThreadArena::getInstance() {
+    return Simulator::current()->arena;
+}
+
+// Expects the arena mutex to be held. Records of a slab are handed out in
+// address order so threads created together sit next to each other.
+void ThreadArena::grow() {
+    Record* slab = new Record[THREADS_PER_SLAB];
+    slabs.push_back(slab);
+    for (int x = THREADS_PER_SLAB - 1; x >= 0; x--) {
+        slab[x].arena = this;
+        slab[x].nextFree = freeRecords;
+        freeRecords = &slab[x];
+    }
+}
+
+// Unlike the policy mutex, the arena mutex does not hold back pauses: the
+// dispatcher never allocates threads, so a thread paused while holding it only
+// delays other threads that do, as it would inside malloc.
+Thread* ThreadArena::allocate(const char* name) {
+    pthread_mutex_lock(&arenaMutex);
+    if (freeRecords == NULL)
+        grow();
+    Record* record = freeRecords;
+    freeRecords = record->nextFree;
+    record->nextFree = NULL;
+    size_t length = strlen(name);
+    if (length < (size_t)THREAD_NAME_CAPACITY) {
+        memcpy(record->name, name, length + 1);
+        record->thread.name = record->name;
+        record->longName = longNames.end();
+    } else {
+        // Entries of a map stay where they are while it changes, so the name
+        // does too until the last record using it is released.
+        record->longName =
+            longNames.insert(pair<string, int>(name, 0)).first;
+        record->longName->second++;
+        record->thread.name =
+            const_cast<char*>(record->longName->first.c_str());
+    }
+    pthread_mutex_unlock(&arenaMutex);
+    record->thread.priority = DEFAULT_PRI;
+    record->thread.func = NULL;
+    record->thread.arg = NULL;
+    record->thread.state = CREATED;
+    record->thread.originalPriority = DEFAULT_PRI;
+    record->thread.slot = NO_THREAD_SLOT;
+    return &record->thread;
+}
+
+void ThreadArena::release(Thread* thread) {
+    if (thread == NULL)
+        return;
+    // The thread is the first member, so the record starts where it does.
+    Record* record = (Record*)thread;
+    record->arena->put(record);
+}
+
+void ThreadArena::put(Record* record) {
+    pthread_mutex_lock(&arenaMutex);
+    if (record->longName != longNames.end() &&
+        --record->longName->second == 0)
+        longNames.erase(record->longName);
+    record->nextFree = freeRecords;
+    freeRecords = record;
+    pthread_mutex_unlock(&arenaMutex);
+}
+
+Thread* allocateThread(const char* name) {
+    return ThreadArena::getInstance()->allocate(name);
+}
+
+void freeThread(Thread* thread) {
+    ThreadManager::forgetThread(thread);
+    ThreadArena::release(thread);
+}
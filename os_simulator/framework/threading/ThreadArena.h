@@ -0,0 +1,56 @@
+#ifndef OS_THREADING_THREADARENA_H
+#define OS_THREADING_THREADARENA_H
+
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Thread.h"
+#include "ThreadingConstants.h"
+
+using namespace std;
+
+struct Simulator;
+
+namespace Threading {
+
+/**
+ * Fixed-size records for Thread objects, carved out of slabs that are never
+ * given back. A freed record goes on a free list and is handed out again by
+ * the next allocation, so creating and destroying threads stops allocating
+ * once the slabs hold as many threads as were ever alive at once. Names that
+ * fit are stored in the record itself; longer ones are interned, shared by
+ * every record with the same name and dropped with the last of them.
+ *
+ * Each simulator owns an arena rather than its ThreadManager because threads
+ * are usually destroyed after stopSystem has destroyed the ThreadManager. A
+ * record goes back to the arena it came from, whichever simulator frees it.
+ */
+class ThreadArena {
+   public:
+    static ThreadArena* getInstance();
+    static void release(Thread* thread);
+    Thread* allocate(const char* name);
+
+   private:
+    friend struct ::Simulator;
+    typedef struct Record {
+        Thread thread;
+        char name[THREAD_NAME_CAPACITY];
+        map<string, int>::iterator longName;
+        ThreadArena* arena;
+        Record* nextFree;
+    } Record;
+
+    ThreadArena();
+    ~ThreadArena();
+    void grow();
+    void put(Record* record);
+    pthread_mutex_t arenaMutex;
+    vector<Record*> slabs;
+    Record* freeRecords;
+    map<string, int> longNames;
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_THREADARENA_H
@@ -1,5 +1,10 @@
 #include "ThreadManager.h"
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cerrno>
 #include "InternalThread.h"
 #include "io/InternalLogger.h"
@@ -7,9 +12,11 @@
 using namespace std;
 using namespace Threading;
 
-ThreadManager* ThreadManager::singleton = NULL;
-InternalThread* ThreadManager::threadToSignal = NULL;
-pthread_mutex_t ThreadManager::threadSignalMutex;
+static long long monotonicNanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
 
 // This can also be resolved using lambdas, std::bind, or simply relying on
 // undefined behavior.
@@ -17,50 +24,294 @@ void* ThreadManager::startIdleThread(ThreadManager* threadManager) {
     return threadManager->idleFunc();
 }
 
-ThreadManager::ThreadManager() {
+ThreadManager::ThreadManager(Simulator* simulator) {
+    this->simulator = simulator;
     tick = 0;
     idleThread = shared_ptr<InternalThread>(
         new InternalThread((void* (*)(void*)) & startIdleThread, this));
-    pthread_mutex_init(&runningThreadMutex, NULL);
-    pthread_mutex_init(&shutdownMutex, NULL);
-    pthread_mutex_init(&threadMappingMutex, NULL);
-    pthread_mutex_init(&threadSignalMutex, NULL);
-    runningThread = idleThread;
+    pthread_mutex_init(&finishMutex, NULL);
+    pthread_cond_init(&allTerminated, NULL);
+    pthread_mutex_init(&statsMutex, NULL);
+    pthread_mutex_init(&policyMutex, NULL);
+    memset(&stats, 0, sizeof(stats));
+    memset(&timing, 0, sizeof(timing));
+    timing.nominalNanos = MICROSECONDS_TICK * 1000LL;
+    trace = NULL;
+    creationsApplied = 0;
+    holdCreations = false;
+    statsPage = NULL;
+    policy = NULL;
+    realtime = new RealtimeClass();
     InternalLogger::init();
     keepRunning = true;
-    lockManager = LockManager::getInstance();
+    liveThreads = 0;
+    lockManager = simulator->lockManager;
 }
 
 ThreadManager::~ThreadManager() {
-    pthread_mutex_destroy(&runningThreadMutex);
-    pthread_mutex_destroy(&shutdownMutex);
-    pthread_mutex_destroy(&threadMappingMutex);
-    pthread_mutex_destroy(&threadSignalMutex);
+    pthread_mutex_destroy(&finishMutex);
+    pthread_cond_destroy(&allTerminated);
+    pthread_mutex_destroy(&statsMutex);
+    pthread_mutex_destroy(&policyMutex);
+    for (vector<InternalThread*>::iterator thread = forgotten.begin();
+         thread != forgotten.end(); thread++) {
+        delete *thread;
+    }
+    delete trace;
+    delete statsPage;
+    delete policy;
+    delete realtime;
 }
 
-void ThreadManager::start() {
+void ThreadManager::start(const char* policyName) {
     if (InternalLogger::getLogger().isVerbose()) {
         InternalLogger::getLogger() << "Starting system\n";
         InternalLogger::getLogger().flush();
     }
+    policy = SchedulerPolicy::create(policyName);
+    if (policy == NULL) {
+        InternalLogger::eventSink() << "[ThreadManager] "
+                                    << "Unknown scheduling policy '"
+                                    << policyName << "', using the default\n";
+        InternalLogger::getLogger().flush();
+        policy = SchedulerPolicy::create(NULL);
+    }
+    if (!simulator->claimCallbacks() && policy->usesStudentCallbacks()) {
+        InternalLogger::eventSink()
+            << "[ThreadManager] Another simulator is using the student "
+            << "callbacks, using '" << FALLBACK_POLICY << "' instead\n";
+        InternalLogger::getLogger().flush();
+        delete policy;
+        policy = SchedulerPolicy::create(FALLBACK_POLICY);
+    }
+    trace = ScheduleTrace::openConfigured();
+    holdCreations = isReplaying();
+    statsPage = StatsPublisher::openConfigured();
     idleThread->start();
     if (InternalLogger::getLogger().isVerbose()) {
         InternalLogger::getLogger()
-            << "System started on tick " << tick << "\n";
+            << "System started on tick " << tick.load() << "\n";
+        InternalLogger::getLogger().flush();
+    }
+}
+
+void ThreadManager::recordTick(bool idle,
+                               bool continued,
+                               long long schedulerNanos,
+                               long long switchNanos,
+                               bool preempted) {
+    pthread_mutex_lock(&statsMutex);
+    stats.ticks = tick;
+    if (idle) {
+        stats.idleTicks++;
+    } else if (continued) {
+        stats.continuations++;
+    } else {
+        stats.dispatches++;
+    }
+    if (preempted)
+        stats.preemptions++;
+    stats.schedulerNanos += schedulerNanos;
+    stats.switchNanos += switchNanos;
+    if (statsPage == NULL) {
+        pthread_mutex_unlock(&statsMutex);
+        return;
+    }
+    StatsPageCounters counters;
+    counters.tick = stats.ticks;
+    counters.readyThreads = stats.readyThreads;
+    counters.sleepingThreads = stats.sleepingThreads;
+    counters.blockedThreads = stats.blockedThreads;
+    counters.contextSwitches = stats.dispatches;
+    counters.preemptions = stats.preemptions;
+    memcpy(counters.readyByPriority, stats.readyByPriority,
+           sizeof(counters.readyByPriority));
+    pthread_mutex_unlock(&statsMutex);
+    lockManager->getContentionTotals(&counters.lockContentions,
+                                     &counters.lockWaitTicks);
+    statsPage->publish(&counters);
+}
+
+// Bucket of a TickTimingStats histogram for a duration.
+static int timingBucket(long long nanos) {
+    long long micros = nanos / 1000;
+    if (micros < 2)
+        return 0;
+    int bucket = 63 - __builtin_clzll(micros);
+    return bucket < TIMING_BUCKETS ? bucket : TIMING_BUCKETS - 1;
+}
+
+void ThreadManager::recordSwitch(long long nanos) {
+    pthread_mutex_lock(&statsMutex);
+    timing.switchHistogram[timingBucket(nanos)]++;
+    pthread_mutex_unlock(&statsMutex);
+}
+
+// A tick runs from one increment of the tick to the next.
+void ThreadManager::recordTiming(long long tickNanos, long long sliceNanos) {
+    long long overrun = tickNanos - timing.nominalNanos;
+    long long threshold = simulator->overrunWarningNanos;
+    bool warn = threshold > 0 && overrun > threshold;
+    pthread_mutex_lock(&statsMutex);
+    timing.ticks++;
+    timing.driftNanos += overrun;
+    if (overrun > 0) {
+        timing.overruns++;
+        timing.overrunNanos += overrun;
+        if (overrun > timing.maxOverrunNanos)
+            timing.maxOverrunNanos = overrun;
+    }
+    if (warn)
+        timing.overrunWarnings++;
+    timing.tickHistogram[timingBucket(tickNanos)]++;
+    timing.overheadHistogram[timingBucket(tickNanos - sliceNanos)]++;
+    pthread_mutex_unlock(&statsMutex);
+    if (warn) {
+        InternalLogger::eventSink()
+            << "[ThreadManager] "
+            << "Tick " << tick.load() << " took " << tickNanos / 1000
+            << " us, " << overrun / 1000 << " us longer than it should\n";
         InternalLogger::getLogger().flush();
     }
 }
 
-void ThreadManager::setRunningThread(shared_ptr<InternalThread> running) {
-    pthread_mutex_lock(&runningThreadMutex);
-    runningThread = running;
-    pthread_mutex_unlock(&runningThreadMutex);
+bool ThreadManager::isReplaying() {
+    return trace != NULL && trace->getMode() == ScheduleTrace::TRACE_REPLAY;
+}
+
+// Reads the next tick of the replay: its decision and, for a dispatch, the
+// record that ends the slice. Once the recording runs out the replay is over
+// and the threads it held back go to the scheduler.
+bool ThreadManager::readDecision(TraceRecord* decision, TraceRecord* sliceEnd) {
+    if (trace->read(decision)) {
+        if (decision->event == TRACE_DISPATCH)
+            trace->read(sliceEnd);
+        return true;
+    }
+    InternalLogger::eventSink() << "[ThreadManager] "
+                                << "Replay finished, scheduling normally\n";
+    InternalLogger::getLogger().flush();
+    delete trace;
+    trace = NULL;
+    sigset_t oldSet;
+    lockPolicy(&oldSet);
+    holdCreations = false;
+    releaseCreations(heldCreations.size());
+    unlockPolicy(&oldSet);
+    return false;
+}
+
+// Created threads are handed to the scheduler on the ticks they were in the
+// recording. Those created from outside the simulation turn up whenever their
+// creator gets to them, so the replay waits for them rather than run ahead.
+void ThreadManager::awaitCreations(int count) {
+    sigset_t oldSet;
+    lockPolicy(&oldSet);
+    while (creationsApplied + (int)heldCreations.size() < count &&
+           keepRunning) {
+        unlockPolicy(&oldSet);
+        usleep(REPLAY_POLL_MICROSECONDS);
+        lockPolicy(&oldSet);
+    }
+    releaseCreations(count - creationsApplied);
+    unlockPolicy(&oldSet);
+}
+
+// Expects the policy mutex to be held. Hands the first count threads held
+// back by the replay to the scheduler.
+void ThreadManager::releaseCreations(int count) {
+    if (count <= 0)
+        return;
+    if (count > (int)heldCreations.size())
+        count = heldCreations.size();
+    for (int x = 0; x < count; x++) {
+        handOver(heldCreations[x]);
+    }
+    heldCreations.erase(heldCreations.begin(), heldCreations.begin() + count);
+}
+
+// Replaces the scheduler's choice with the recorded one. The scheduler still
+// runs every tick so its own state advances exactly as it did when recording.
+// sliceEnd is left a preemption with no call count when there is no recorded
+// slice to follow.
+Thread* ThreadManager::replayDecision(Thread* chosen,
+                                      const TraceRecord& decision,
+                                      TraceRecord* sliceEnd) {
+    Thread* replayed = NULL;
+    if (decision.event == TRACE_DISPATCH) {
+        InternalThread* recorded = threads.at(decision.thread);
+        if (recorded != NULL && recorded->getState() != TERMINATED)
+            replayed = recorded->getExternalThread();
+        if (replayed == NULL) {
+            sliceEnd->event = TRACE_PREEMPT;
+            sliceEnd->count = -1;
+            replayed = chosen;
+        }
+    }
+    if (replayed != chosen || decision.tick != tick) {
+        if (InternalLogger::getLogger().isVerbose()) {
+            InternalLogger::eventSink()
+                << "[ThreadManager] "
+                << "Replay diverged: recording ran thread " << decision.thread
+                << " on tick " << decision.tick << "\n";
+            InternalLogger::getLogger().flush();
+        }
+        pthread_mutex_lock(&statsMutex);
+        stats.replayDivergences++;
+        pthread_mutex_unlock(&statsMutex);
+    }
+    return replayed;
+}
+
+// Pauses a thread whose slice went on past the end of its tick, or reaps it
+// if it returned in the meantime. Returns whether it had to be paused.
+bool ThreadManager::endSlice(InternalThread* thread, long long* switchNanos) {
+    Thread* externalThread = thread->getExternalThread();
+    bool paused = false;
+    if (thread->getState() != TERMINATED) {
+        if (InternalLogger::getLogger().isVerbose()) {
+            InternalLogger::eventSink()
+                << "[ThreadManager] "
+                << "Pausing thread " << externalThread->name << "\n";
+            InternalLogger::getLogger().flush();
+        }
+        long long switchStart = monotonicNanos();
+        thread->pause();
+        long long pauseNanos = monotonicNanos() - switchStart;
+        *switchNanos += pauseNanos;
+        recordSwitch(pauseNanos);
+        paused = true;
+        if (thread->getState() != TERMINATED &&
+            InternalLogger::getLogger().isVerbose()) {
+            InternalLogger::eventSink()
+                << "[ThreadManager] "
+                << "Successfully paused thread " << externalThread->name
+                << "\n";
+            InternalLogger::getLogger().flush();
+        }
+    }
+    if (thread->getState() == TERMINATED) {
+        // The thread returned while the slice was closing; reap it instead of
+        // leaving it parked.
+        thread->join();
+        sigset_t oldSet;
+        lockPolicy(&oldSet);
+        retireThread(externalThread);
+        unlockPolicy(&oldSet);
+    }
+    return paused;
 }
 
 void* ThreadManager::idleFunc() {
     bool cont = true;
-    pthread_mutex_lock(&threadMappingMutex);
+    // The thread whose last slice ran past the end of its tick without being
+    // paused, in case the scheduler picks it again.
+    InternalThread* carried = NULL;
     while (cont || !areAllThreadsTerminated()) {
+        long long tickStart = monotonicNanos();
+        // Time spent letting a thread run or sleeping through an idle tick;
+        // the rest of the tick is the dispatcher's own.
+        long long sliceNanos = 0;
         tick++;
         InternalLogger::getLogger().setTick(tick);
         InternalLogger::getLogger().flush();
@@ -70,15 +321,73 @@ void* ThreadManager::idleFunc() {
                                         << "\n";
             InternalLogger::getLogger().flush();
         }
-        Thread* newThread = nextThreadToRun(tick);
+        TraceRecord decision;
+        TraceRecord replayedEnd = {tick, -1, -1, TRACE_PREEMPT};
+        bool replaying =
+            isReplaying() && readDecision(&decision, &replayedEnd);
+        if (replaying)
+            awaitCreations(decision.count);
+        long long schedulerStart = monotonicNanos();
+        sigset_t oldSet;
+        lockPolicy(&oldSet);
+        // Threads freed since the last tick was dispatched are no longer used
+        // by it, so the next threads created can run on them.
+        for (vector<InternalThread*>::iterator thread = forgotten.begin();
+             thread != forgotten.end(); thread++) {
+            threads.recycle(*thread);
+        }
+        forgotten.clear();
+        expireWaits(tick);
+        table.wakeSleepers(tick);
+        countThreads();
+        realtime->tick(tick);
+        policy->tick(tick);
+        Thread* newThread = realtime->pick(tick);
+        if (newThread == NULL)
+            newThread = policy->pick(tick);
+        int created = creationsApplied;
+        unlockPolicy(&oldSet);
+        long long schedulerNanos = monotonicNanos() - schedulerStart;
+        if (replaying)
+            newThread = replayDecision(newThread, decision, &replayedEnd);
+        long long switchNanos = 0;
+        bool preempted = false;
+        bool continued = false;
+        if (carried != NULL) {
+            if (newThread == carried->getExternalThread() &&
+                carried->keepsRunning()) {
+                continued = true;
+            } else {
+                preempted = endSlice(carried, &switchNanos);
+                // A pick of a thread that returned in the meantime is void.
+                if (newThread == carried->getExternalThread() &&
+                    carried->getState() == TERMINATED)
+                    newThread = NULL;
+            }
+            carried = NULL;
+        }
         if (newThread == NULL) {
-            pthread_mutex_unlock(&threadMappingMutex);
-            usleep(MICROSECONDS_TICK);
+            recordTick(true, false, schedulerNanos, switchNanos, preempted);
+            if (trace != NULL && !replaying)
+                trace->write(tick, -1, TRACE_IDLE, created);
+            if (!replaying) {
+                long long sleepStart = monotonicNanos();
+                usleep(MICROSECONDS_TICK);
+                sliceNanos = monotonicNanos() - sleepStart;
+            }
         } else {
-            shared_ptr<InternalThread> currentThread = threadMapping[newThread];
+            InternalThread* currentThread = threads.find(newThread);
+            if (trace != NULL && !replaying)
+                trace->write(tick, currentThread->getSequence(),
+                             TRACE_DISPATCH, created);
+            // A replayed preemption ends once the thread has made as many
+            // calls into the simulator as it did in the recording.
+            bool limited = replaying && replayedEnd.event == TRACE_PREEMPT;
+            bool untimed = replaying && (!limited || replayedEnd.count >= 0);
+            currentThread->allowCalls(limited ? replayedEnd.count : -1);
+            long long switchStart = monotonicNanos();
             switch (currentThread->getState()) {
                 case CREATED: {
-                    setRunningThread(currentThread);
                     if (InternalLogger::getLogger().isVerbose()) {
                         InternalLogger::eventSink()
                             << "[ThreadManager] "
@@ -89,7 +398,6 @@ void* ThreadManager::idleFunc() {
                     break;
                 }
                 case PAUSED: {
-                    setRunningThread(currentThread);
                     if (InternalLogger::getLogger().isVerbose()) {
                         InternalLogger::eventSink()
                             << "[ThreadManager] "
@@ -106,8 +414,34 @@ void* ThreadManager::idleFunc() {
                     }
                     break;
                 }
+                default:
+                    // A carried thread is still running.
+                    break;
+            }
+            long long startNanos = monotonicNanos() - switchStart;
+            switchNanos += startNanos;
+            if (!continued)
+                recordSwitch(startNanos);
+            long long sliceStart = monotonicNanos();
+            int status;
+            if (untimed) {
+                // The recorded slice ended at a yield, an exit or a number of
+                // calls, so there is nothing to time; wait for the thread to
+                // get there. A thread that does not has diverged from the
+                // recording.
+                if (!currentThread->waitForSliceEnd(REPLAY_SLICE_TICKS)) {
+                    pthread_mutex_lock(&statsMutex);
+                    stats.replayDivergences++;
+                    pthread_mutex_unlock(&statsMutex);
+                }
+                status = currentThread->getState() == TERMINATED
+                             ? currentThread->join()
+                             : ETIMEDOUT;
+            } else {
+                status = currentThread->joinWithTimeout();
             }
-            int status = currentThread->joinWithTimeout();
+            sliceNanos = monotonicNanos() - sliceStart;
+            bool parkedAtEnd = currentThread->isParked();
             if (InternalLogger::getLogger().isVerbose()) {
                 InternalLogger::eventSink()
                     << "[ThreadManager] "
@@ -115,7 +449,6 @@ void* ThreadManager::idleFunc() {
                     << status << "\n";
                 InternalLogger::getLogger().flush();
             }
-            setRunningThread(idleThread);
             if (InternalLogger::getLogger().isVerbose()) {
                 InternalLogger::eventSink()
                     << "[ThreadManager] "
@@ -123,18 +456,16 @@ void* ThreadManager::idleFunc() {
                 InternalLogger::getLogger().flush();
             }
             if (status == ETIMEDOUT || status == EBUSY) {
-                if (InternalLogger::getLogger().isVerbose()) {
-                    InternalLogger::eventSink()
-                        << "[ThreadManager] "
-                        << "Pausing thread " << newThread->name << "\n";
-                    InternalLogger::getLogger().flush();
-                }
-                currentThread->pause();
-                if (InternalLogger::getLogger().isVerbose()) {
-                    InternalLogger::eventSink() << "[ThreadManager] "
-                                                << "Successfully paused thread "
-                                                << newThread->name << "\n";
-                    InternalLogger::getLogger().flush();
+                // A recorded slice has to end with the tick so the calls made
+                // during it are counted with it.
+                bool recording = trace != NULL && !replaying;
+                if (parkedAtEnd || recording) {
+                    preempted = endSlice(currentThread, &switchNanos) ||
+                                preempted;
+                } else {
+                    // Still running, so the pause can wait until the next
+                    // tick shows whether another thread is to run.
+                    carried = currentThread;
                 }
             } else if (status == 0) {
                 if (InternalLogger::getLogger().isVerbose()) {
@@ -144,29 +475,45 @@ void* ThreadManager::idleFunc() {
                     InternalLogger::getLogger().flush();
                 }
                 currentThread->terminated();
+                lockPolicy(&oldSet);
+                retireThread(newThread);
+                unlockPolicy(&oldSet);
             }
-            pthread_mutex_lock(&shutdownMutex);
-            cont = keepRunning;
-            pthread_mutex_unlock(&shutdownMutex);
-            pthread_mutex_unlock(&threadMappingMutex);
+            int calls = currentThread->takeSliceCalls();
+            if (trace != NULL && !replaying) {
+                TraceEvent end = TRACE_PREEMPT;
+                if (currentThread->getState() == TERMINATED) {
+                    end = TRACE_EXIT;
+                } else if (parkedAtEnd) {
+                    end = TRACE_YIELD;
+                }
+                trace->write(tick, currentThread->getSequence(), end, calls);
+            }
+            recordTick(false, continued, schedulerNanos, switchNanos,
+                       preempted);
         }
+        recordTiming(monotonicNanos() - tickStart, sliceNanos);
+        // Empty ticks must also observe shutdown or the loop never exits once
+        // every thread has finished before stopSystem is called.
+        cont = keepRunning;
+    }
+    if (carried != NULL) {
+        long long switchNanos = 0;
+        endSlice(carried, &switchNanos);
     }
+    // Applies what the last threads posted before they ended.
+    sigset_t oldSet;
+    lockPolicy(&oldSet);
+    unlockPolicy(&oldSet);
     InternalLogger::getLogger().flush();
+    return NULL;
 }
 
+// Threads are counted from createThread until the dispatcher reaps them, so
+// the check does not depend on how many threads have ever been created.
 bool ThreadManager::areAllThreadsTerminated() {
-    if (InternalLogger::getLogger().isVerbose()) {
-        InternalLogger::eventSink()
-            << "[ThreadManager] "
-            << "Checking if all threads are terminated\n";
-        InternalLogger::getLogger().flush();
-    }
-    for (map<Thread*, shared_ptr<InternalThread>>::iterator iter =
-             threadMapping.begin();
-         iter != threadMapping.end(); iter++) {
-        if (iter->second->getState() != TERMINATED)
-            return false;
-    }
+    if (liveThreads > 0)
+        return false;
     if (InternalLogger::getLogger().isVerbose()) {
         InternalLogger::eventSink() << "[ThreadManager] "
                                     << "All threads have been terminated\n";
@@ -176,35 +523,440 @@ bool ThreadManager::areAllThreadsTerminated() {
 }
 
 void ThreadManager::shutdown() {
-    pthread_mutex_t shutdownMutex = ThreadManager::getInstance()->shutdownMutex;
-    pthread_mutex_lock(&shutdownMutex);
     ThreadManager::getInstance()->keepRunning = false;
-    pthread_mutex_unlock(&shutdownMutex);
 }
 
 ThreadManager* ThreadManager::getInstance() {
-    if (!ThreadManager::singleton) {
-        ThreadManager::singleton = new ThreadManager();
+    Simulator* simulator = Simulator::current();
+    if (!simulator->threadManager) {
+        simulator->threadManager = new ThreadManager(simulator);
+    }
+    return simulator->threadManager;
+}
+
+// Threads outside the simulation count as the idle thread, which has no
+// Thread of its own.
+InternalThread* ThreadManager::currentThread() {
+    InternalThread* thread = InternalThread::current();
+    return thread != NULL ? thread : idleThread.get();
+}
+
+// Policy hooks run on simulated threads too. A thread paused by the
+// dispatcher while holding policyMutex would stall the next pick, so pauses
+// are held back until the mutex is released.
+void ThreadManager::lockPolicy(sigset_t* oldSet) {
+    sigset_t sigSet;
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &sigSet, oldSet);
+    pthread_mutex_lock(&policyMutex);
+    // Whoever takes the mutex applies what was posted before, so nothing
+    // done under it can overtake an earlier event.
+    Event event;
+    while (policy != NULL && events.pop(&event)) {
+        applyEvent(event);
     }
-    return ThreadManager::singleton;
 }
 
-shared_ptr<InternalThread> ThreadManager::currentThread() {
-    return runningThread;
+void ThreadManager::unlockPolicy(sigset_t* oldSet) {
+    pthread_mutex_unlock(&policyMutex);
+    pthread_sigmask(SIG_SETMASK, oldSet, NULL);
+}
+
+// Real-time threads are scheduled by the real-time class, everything else by
+// the policy chosen at startSystem.
+SchedulerPolicy* ThreadManager::policyFor(Thread* thread) {
+    if (realtime->contains(thread))
+        return realtime;
+    return policy;
 }
 
 void ThreadManager::sleepCurrentThread() {
-    runningThread->stopExecution();
+    InternalThread* thread = currentThread();
+    Thread* externalThread = thread->getExternalThread();
+    sigset_t oldSet;
+    lockPolicy(&oldSet);
+    policyFor(externalThread)->yield(externalThread);
+    unlockPolicy(&oldSet);
+    thread->stopExecution();
+}
+
+void ThreadManager::blockCurrentThread(int wakeTick) {
+    InternalThread* thread = currentThread();
+    Thread* externalThread = thread->getExternalThread();
+    sigset_t oldSet;
+    lockPolicy(&oldSet);
+    policyFor(externalThread)->block(externalThread, wakeTick);
+    if (wakeTick == NO_WAKE_TICK) {
+        table.setBlocked(externalThread, NO_WAKE_TICK, NULL);
+    } else {
+        table.setSleeping(externalThread, wakeTick);
+    }
+    unlockPolicy(&oldSet);
+    thread->stopExecution();
+}
+
+// A thread changing its own priority goes on to read it, so that change is
+// made before returning. Taking the mutex applies the events posted before
+// it first.
+void ThreadManager::setPriority(Thread* thread, int priority) {
+    Event event = {EVENT_PRIORITY, thread, priority};
+    InternalThread* current = InternalThread::current();
+    if (current == NULL || current->getExternalThread() != thread) {
+        post(event);
+        return;
+    }
+    sigset_t oldSet;
+    lockPolicy(&oldSet);
+    applyEvent(event);
+    unlockPolicy(&oldSet);
+}
+
+// Events are applied by the next thread to take the policy mutex, at the
+// latest the dispatcher at the start of the next tick. When the queue is full
+// the poster drains it and tries again; applying its event directly could
+// overtake one whose slot is reserved but not yet filled.
+void ThreadManager::post(const Event& event) {
+    while (!events.push(event)) {
+        sigset_t oldSet;
+        lockPolicy(&oldSet);
+        unlockPolicy(&oldSet);
+        sched_yield();
+    }
+}
+
+// Expects the policy mutex to be held.
+void ThreadManager::applyEvent(const Event& event) {
+    switch (event.type) {
+        case EVENT_CREATE:
+            if (holdCreations)
+                heldCreations.push_back(event.thread);
+            else
+                handOver(event.thread);
+            break;
+        case EVENT_PRIORITY:
+            changePriority(event.thread, event.priority);
+            table.setPriority(event.thread, event.priority, true);
+            break;
+    }
 }
 
-void ThreadManager::createThread(Thread* thread) {
-    pthread_mutex_lock(&threadMappingMutex);
-    threadMapping[thread] = shared_ptr<InternalThread>(
-        new InternalThread(thread->func, thread->arg, thread));
-    pthread_mutex_unlock(&threadMappingMutex);
+// Expects the policy mutex to be held. A replay holds created threads back
+// until the tick the recording handed them over on.
+void ThreadManager::handOver(Thread* thread) {
+    table.add(thread);
+    if (policy != NULL)
+        policy->enqueue(thread);
+    creationsApplied++;
 }
 
+// Expects the policy mutex to be held. A thread waiting in a queue is moved to
+// its new place in line as well.
+void ThreadManager::changePriority(Thread* thread, int priority) {
+    int oldPriority = thread->priority;
+    if (priority == oldPriority)
+        return;
+    thread->priority = priority;
+    table.setPriority(thread, priority, false);
+    SchedulerPolicy* owner = policyFor(thread);
+    if (owner != NULL)
+        owner->priorityChanged(thread, oldPriority);
+    map<Thread*, WaitQueue*>::iterator waiting = waitQueues.find(thread);
+    if (waiting != waitQueues.end())
+        waiting->second->priorityChanged(thread);
+}
+
+// Expects the policy mutex to be held and releases it. The current thread
+// joins the queue and is not dispatched again until wakeFrom takes it out.
+void ThreadManager::waitOn(WaitQueue* queue, sigset_t* oldSet) {
+    blockOn(queue);
+    unlockPolicy(oldSet);
+    parkCurrentThread();
+}
+
+// Expects the policy mutex to be held. The current thread joins the queue but
+// keeps running until it calls parkCurrentThread, so it can still release
+// what it holds. A wakeFrom in between is not lost: the thread is dispatched
+// again once it has parked.
+void ThreadManager::blockOn(WaitQueue* queue) {
+    blockOn(queue, NO_WAKE_TICK);
+}
+
+// Like blockOn, but if nobody wakes the thread before wakeTick it leaves the
+// queue and runs again on that tick, as a sleeping thread would.
+void ThreadManager::blockOn(WaitQueue* queue, int wakeTick) {
+    blockOn(queue, wakeTick, NULL);
+}
+
+// Like blockOn, for a thread waiting to take the lock lockId.
+void ThreadManager::blockOn(WaitQueue* queue,
+                            int wakeTick,
+                            const char* lockId) {
+    Thread* externalThread = currentThread()->getExternalThread();
+    queue->push(externalThread);
+    waitQueues[externalThread] = queue;
+    policyFor(externalThread)->block(externalThread, BLOCK_UNTIL_WOKEN);
+    table.setBlocked(externalThread, wakeTick, lockId);
+}
+
+// Expects the policy mutex to be held. Threads whose wait ran out leave their
+// queue and are ready again; they find out by not having what they waited
+// for.
+void ThreadManager::expireWaits(int currentTick) {
+    expired.clear();
+    table.expiredWaits(currentTick, &expired);
+    for (vector<Thread*>::iterator iter = expired.begin();
+         iter != expired.end(); iter++) {
+        Thread* thread = *iter;
+        map<Thread*, WaitQueue*>::iterator waiting = waitQueues.find(thread);
+        if (waiting != waitQueues.end()) {
+            waiting->second->remove(thread);
+            waitQueues.erase(waiting);
+        }
+        wakeThread(thread);
+    }
+}
+
+void ThreadManager::parkCurrentThread() {
+    InternalThread* thread = currentThread();
+    thread->stopExecution();
+}
+
+// Expects the policy mutex to be held. Makes the first thread in the queue
+// ready again and returns it, or NULL if the queue is empty.
+Thread* ThreadManager::wakeFrom(WaitQueue* queue) {
+    Thread* thread = queue->pop();
+    if (thread == NULL)
+        return NULL;
+    waitQueues.erase(thread);
+    wakeThread(thread);
+    return thread;
+}
+
+// Expects the policy mutex to be held. The thread has returned and is reaped
+// on the tick it ended; threads joining it are ready from the next one.
+void ThreadManager::retireThread(Thread* thread) {
+    policyFor(thread)->dequeue(thread);
+    table.remove(thread);
+    if (--liveThreads == 0) {
+        pthread_mutex_lock(&finishMutex);
+        pthread_cond_broadcast(&allTerminated);
+        pthread_mutex_unlock(&finishMutex);
+    }
+    map<Thread*, vector<Thread*>>::iterator found = joinersOf.find(thread);
+    if (found == joinersOf.end())
+        return;
+    vector<Thread*> joiners = found->second;
+    joinersOf.erase(found);
+    for (vector<Thread*>::iterator joiner = joiners.begin();
+         joiner != joiners.end(); joiner++) {
+        // A joiner of several threads stops waiting for the others.
+        vector<Thread*>& targets = joinTargets[*joiner];
+        for (vector<Thread*>::iterator target = targets.begin();
+             target != targets.end(); target++) {
+            map<Thread*, vector<Thread*>>::iterator others =
+                joinersOf.find(*target);
+            if (others == joinersOf.end())
+                continue;
+            others->second.erase(remove(others->second.begin(),
+                                        others->second.end(), *joiner),
+                                 others->second.end());
+            if (others->second.empty())
+                joinersOf.erase(others);
+        }
+        joinTargets.erase(*joiner);
+        joined[*joiner] = thread;
+        wakeThread(*joiner);
+    }
+}
+
+// Expects the policy mutex to be held.
+void ThreadManager::wakeThread(Thread* thread) {
+    policyFor(thread)->wake(thread);
+    table.setReady(thread);
+}
+
+// Expects the policy mutex to be held. Takes the counts once sleepers due on
+// this tick are ready, before anything is picked.
+void ThreadManager::countThreads() {
+    int ready = table.count(RUN_READY);
+    int sleeping = table.count(RUN_SLEEPING);
+    int blocked = table.count(RUN_BLOCKED);
+    int byPriority[MAX_PRI - MIN_PRI + 1] = {0};
+    table.countReadyByPriority(byPriority);
+    pthread_mutex_lock(&statsMutex);
+    stats.readyThreads = ready;
+    stats.sleepingThreads = sleeping;
+    stats.blockedThreads = blocked;
+    memcpy(stats.readyByPriority, byPriority, sizeof(byPriority));
+    pthread_mutex_unlock(&statsMutex);
+}
+
+// Threads outside the simulation cannot be blocked by the scheduler, so they
+// check back every tick instead.
+Thread* ThreadManager::joinAny(Thread** threads, int count) {
+    InternalThread* thread = currentThread();
+    Thread* externalThread = thread->getExternalThread();
+    vector<InternalThread*> targets;
+    for (int x = 0; x < count; x++) {
+        InternalThread* found = this->threads.find(threads[x]);
+        if (found == NULL || threads[x] == externalThread)
+            break;
+        targets.push_back(found);
+    }
+    if (count <= 0 || (int)targets.size() != count)
+        return NULL;
+
+    while (externalThread == NULL) {
+        for (int x = 0; x < count; x++) {
+            if (targets[x]->getState() == TERMINATED)
+                return threads[x];
+        }
+        usleep(MICROSECONDS_TICK);
+    }
+
+    // A thread that has returned but is not reaped yet is as good as done;
+    // one that has not returned is reaped under the policy mutex, so it
+    // cannot slip past between the check and the queueing.
+    sigset_t oldSet;
+    lockPolicy(&oldSet);
+    for (int x = 0; x < count; x++) {
+        if (targets[x]->getState() == TERMINATED) {
+            unlockPolicy(&oldSet);
+            return threads[x];
+        }
+    }
+    for (int x = 0; x < count; x++) {
+        joinersOf[threads[x]].push_back(externalThread);
+    }
+    joinTargets[externalThread] = vector<Thread*>(threads, threads + count);
+    policyFor(externalThread)->block(externalThread, BLOCK_UNTIL_WOKEN);
+    table.setBlocked(externalThread, NO_WAKE_TICK, NULL);
+    unlockPolicy(&oldSet);
+    thread->stopExecution();
+
+    lockPolicy(&oldSet);
+    Thread* ended = joined[externalThread];
+    joined.erase(externalThread);
+    unlockPolicy(&oldSet);
+    return ended;
+}
+
+bool ThreadManager::createThread(Thread* thread) {
+    return createThread(thread, NULL);
+}
+
+// Only real-time threads are handed to the scheduler right away, as their
+// admission decides what createThread returns.
+bool ThreadManager::createThread(Thread* thread,
+                                 const RealtimeParams* params) {
+    if (params != NULL) {
+        sigset_t oldSet;
+        lockPolicy(&oldSet);
+        bool admitted = realtime->admit(thread, params);
+        if (admitted && !registerThread(thread)) {
+            realtime->dequeue(thread);
+            admitted = false;
+        }
+        if (admitted)
+            table.add(thread);
+        unlockPolicy(&oldSet);
+        if (!admitted) {
+            if (InternalLogger::getLogger().isVerbose()) {
+                InternalLogger::eventSink() << "[ThreadManager] "
+                                            << "Real-time thread "
+                                            << thread->name
+                                            << " not admitted\n";
+                InternalLogger::getLogger().flush();
+            }
+            return false;
+        }
+    } else {
+        if (!registerThread(thread))
+            return false;
+        Event event = {EVENT_CREATE, thread, 0};
+        post(event);
+    }
+    pthread_mutex_lock(&statsMutex);
+    stats.threadsCreated++;
+    pthread_mutex_unlock(&statsMutex);
+    return true;
+}
+
+// The thread counts as live from here, so the dispatcher keeps going until
+// its creation has been applied and it has run. Fails while every slot of the
+// registry is taken.
+bool ThreadManager::registerThread(Thread* thread) {
+    if (threads.add(thread) == NULL) {
+        InternalLogger::eventSink() << "[ThreadManager] "
+                                    << "Too many threads, not creating "
+                                    << thread->name << "\n";
+        InternalLogger::getLogger().flush();
+        return false;
+    }
+    liveThreads++;
+    return true;
+}
+
+// Called as a thread's record is freed. Records are usually freed after
+// stopSystem, when the registry has gone with the ThreadManager.
+void ThreadManager::forgetThread(Thread* thread) {
+    if (thread == NULL)
+        return;
+    RealtimeClass::forgetThreadStats(thread);
+    if (thread->slot == NO_THREAD_SLOT)
+        return;
+    ThreadManager* threadManager = Simulator::current()->threadManager;
+    if (threadManager != NULL)
+        threadManager->forget(thread);
+}
+
+// Gives the slot of a thread that has ended back to the registry. A thread
+// that has returned but is not reaped yet is waited for, as a record handed
+// out again must not still be known to the scheduler; one that has not
+// returned keeps its slot until stopSystem. The dispatcher may still be using
+// the InternalThread, so it is recycled at the start of the next tick.
+void ThreadManager::forget(Thread* thread) {
+    InternalThread* internalThread = threads.find(thread);
+    if (internalThread == NULL || internalThread->getState() != TERMINATED)
+        return;
+    sigset_t oldSet;
+    lockPolicy(&oldSet);
+    while (table.contains(thread)) {
+        unlockPolicy(&oldSet);
+        sched_yield();
+        lockPolicy(&oldSet);
+    }
+    InternalThread* released = threads.release(thread);
+    if (released != NULL)
+        forgotten.push_back(released);
+    unlockPolicy(&oldSet);
+}
+
+int ThreadManager::waitForNextPeriod() {
+    InternalThread* thread = currentThread();
+    Thread* externalThread = thread->getExternalThread();
+    sigset_t oldSet;
+    lockPolicy(&oldSet);
+    int release = tick + 1;
+    if (realtime->contains(externalThread)) {
+        release = realtime->complete(externalThread);
+        table.setSleeping(externalThread, release);
+    } else {
+        policy->yield(externalThread);
+    }
+    unlockPolicy(&oldSet);
+    thread->stopExecution();
+    return release;
+}
+
+// Waits for every thread to be reaped before the idle thread, which only exits
+// once there are none left after shutdown.
 void ThreadManager::waitForFinish() {
+    pthread_mutex_lock(&finishMutex);
+    while (liveThreads > 0)
+        pthread_cond_wait(&allTerminated, &finishMutex);
+    pthread_mutex_unlock(&finishMutex);
     idleThread->join();
     if (InternalLogger::getLogger().isVerbose()) {
         InternalLogger::eventSink() << "[ThreadManager] "
@@ -219,9 +971,12 @@ void ThreadManager::destroyThreadManager() {
                                     << "Destroying thread manager\n";
         InternalLogger::getLogger().flush();
     }
-    if (ThreadManager::singleton) {
-        delete ThreadManager::singleton;
-        ThreadManager::singleton = NULL;
+    Simulator* simulator = Simulator::current();
+    if (simulator->threadManager) {
+        copyStats(&simulator->finalStats);
+        copyTiming(&simulator->finalTiming);
+        delete simulator->threadManager;
+        simulator->threadManager = NULL;
     }
     if (InternalLogger::getLogger().isVerbose()) {
         InternalLogger::eventSink() << "[ThreadManager] "
@@ -230,8 +985,37 @@ void ThreadManager::destroyThreadManager() {
     }
 }
 
+void ThreadManager::copyStats(SchedulerStats* out) {
+    ThreadManager* threadManager = Simulator::current()->threadManager;
+    if (threadManager == NULL) {
+        *out = Simulator::current()->finalStats;
+        return;
+    }
+    pthread_mutex_lock(&threadManager->statsMutex);
+    *out = threadManager->stats;
+    pthread_mutex_unlock(&threadManager->statsMutex);
+}
+
+void ThreadManager::copyTiming(TickTimingStats* out) {
+    ThreadManager* threadManager = Simulator::current()->threadManager;
+    if (threadManager == NULL) {
+        *out = Simulator::current()->finalTiming;
+        return;
+    }
+    pthread_mutex_lock(&threadManager->statsMutex);
+    *out = threadManager->timing;
+    pthread_mutex_unlock(&threadManager->statsMutex);
+}
+
+void ThreadManager::setOverrunWarning(int overrunMicros) {
+    Simulator::current()->overrunWarningNanos = overrunMicros * 1000LL;
+}
+
+// Signals are only sent to simulated threads, which handle them themselves.
 void ThreadManager::signalFunc(int sig) {
-    threadToSignal->runningSigFunc(sig);
+    InternalThread* thread = InternalThread::current();
+    if (thread != NULL)
+        thread->runningSigFunc(sig);
 }
 
 int ThreadManager::currentTick() {
@@ -242,13 +1026,16 @@ Thread* getCurrentThread() {
     return ThreadManager::getInstance()->currentThread()->getExternalThread();
 }
 
-void createThread(Thread* thread) {
-    ThreadManager::getInstance()->createThread(thread);
+bool createThread(Thread* thread) {
+    return ThreadManager::getInstance()->createThread(thread);
 }
 
 void startSystem() {
-    initializeCallback();
-    ThreadManager::getInstance()->start();
+    startSystem(NULL);
+}
+
+void startSystem(const char* policyName) {
+    ThreadManager::getInstance()->start(policyName);
 }
 
 void stopSystem() {
@@ -269,14 +1056,56 @@ void stopSystem() {
                                     << "All threads finished\n";
         InternalLogger::getLogger().flush();
     }
-    shutdownCallback();
+    Simulator::current()->releaseCallbacks();
     ThreadManager::destroyThreadManager();
 }
 
 void stopExecutingThreadForCycle() {
+    SimulatorCall call;
     ThreadManager::getInstance()->sleepCurrentThread();
 }
 
+void blockCurrentThread(int wakeTick) {
+    SimulatorCall call;
+    ThreadManager::getInstance()->blockCurrentThread(wakeTick);
+}
+
+void setThreadPriority(Thread* thread, int priority) {
+    ThreadManager::getInstance()->setPriority(thread, priority);
+}
+
+bool createRealtimeThread(Thread* thread, const RealtimeParams* params) {
+    return ThreadManager::getInstance()->createThread(thread, params);
+}
+
+int waitForNextPeriod() {
+    SimulatorCall call;
+    return ThreadManager::getInstance()->waitForNextPeriod();
+}
+
 int getCurrentTick() {
+    SimulatorCall call;
     return ThreadManager::getInstance()->currentTick();
+}
+
+bool joinThread(Thread* thread) {
+    SimulatorCall call;
+    return ThreadManager::getInstance()->joinAny(&thread, 1) != NULL;
+}
+
+Thread* joinAny(Thread** threads, int count) {
+    SimulatorCall call;
+    return ThreadManager::getInstance()->joinAny(threads, count);
+}
+
+void getSchedulerStats(SchedulerStats* stats) {
+    ThreadManager::copyStats(stats);
+}
+
+void getTickTimingStats(TickTimingStats* stats) {
+    ThreadManager::copyTiming(stats);
+}
+
+void setTickOverrunWarning(int overrunMicros) {
+    ThreadManager::setOverrunWarning(overrunMicros);
 }
\ No newline at end of file
@@ -1,52 +1,137 @@
 #ifndef OS_THREADING_THREADMANAGER_H
 #define OS_THREADING_THREADMANAGER_H
 
+#include <atomic>
 #include <cstdlib>
 #include <map>
 #include <memory>
+#include <set>
 #include <vector>
+#include "EventQueue.h"
 #include "InternalThread.h"
 #include "LockManager.h"
+#include "ScheduleTrace.h"
+#include "SimulatorContext.h"
+#include "Stats.h"
+#include "StatsPublisher.h"
 #include "Thread.h"
+#include "ThreadRegistry.h"
+#include "ThreadTable.h"
+#include "WaitQueue.h"
+#include "scheduling/RealtimeClass.h"
+#include "scheduling/SchedulerPolicy.h"
 
 using namespace std;
 
 namespace Threading {
+
+/**
+ * Runs the simulation from the idle thread, which dispatches one thread per
+ * tick. Its state is split by who needs it: scheduling state such as the
+ * policy, the thread table, wait queues and joins is guarded by the policy
+ * mutex; InternalThreads are owned by the registry, which locks for itself;
+ * counters by statsMutex. The tick, the live-thread count and the shutdown
+ * flag are atomic. Every critical section is short, and the dispatcher holds
+ * none of them while a simulated thread runs.
+ *
+ * Each Simulator has its own, made by getInstance the first time the
+ * simulator is used and destroyed by stopSystem.
+ */
 class ThreadManager {
     friend class InternalThread;
+    friend class LockManager;
+    friend struct ::Simulator;
 
    private:
-    ThreadManager();
+    ThreadManager(Simulator* simulator);
     ~ThreadManager();
+    Simulator* simulator;
     vector<InternalThread> waitList;
-    int tick;
-    shared_ptr<InternalThread> runningThread;
+    atomic<int> tick;
     shared_ptr<InternalThread> idleThread;
-    static ThreadManager* singleton;
     void* idleFunc();
-    pthread_mutex_t runningThreadMutex;
-    bool keepRunning;
-    pthread_mutex_t shutdownMutex;
-    pthread_mutex_t threadMappingMutex;
-    void setRunningThread(shared_ptr<InternalThread> running);
-    map<Thread*, shared_ptr<InternalThread>> threadMapping;
+    atomic<bool> keepRunning;
+    pthread_mutex_t finishMutex;
+    pthread_cond_t allTerminated;
+    atomic<int> liveThreads;
+    ThreadRegistry threads;
+    ScheduleTrace* trace;
+    bool isReplaying();
+    bool readDecision(TraceRecord* decision, TraceRecord* sliceEnd);
+    void awaitCreations(int count);
+    Thread* replayDecision(Thread* chosen,
+                           const TraceRecord& decision,
+                           TraceRecord* sliceEnd);
+    SchedulerPolicy* policy;
+    RealtimeClass* realtime;
+    pthread_mutex_t policyMutex;
+    SchedulerPolicy* policyFor(Thread* thread);
+    ThreadTable table;
+    EventQueue events;
+    void post(const Event& event);
+    void applyEvent(const Event& event);
+    void handOver(Thread* thread);
+    void releaseCreations(int count);
+    int creationsApplied;
+    bool holdCreations;
+    vector<Thread*> heldCreations;
+    bool registerThread(Thread* thread);
+    void forget(Thread* thread);
+    vector<InternalThread*> forgotten;
+    map<Thread*, WaitQueue*> waitQueues;
+    vector<Thread*> expired;
+    map<Thread*, vector<Thread*>> joinersOf;
+    map<Thread*, vector<Thread*>> joinTargets;
+    map<Thread*, Thread*> joined;
+    void retireThread(Thread* thread);
+    void wakeThread(Thread* thread);
+    void countThreads();
+    void expireWaits(int currentTick);
     bool areAllThreadsTerminated();
+    bool endSlice(InternalThread* thread, long long* switchNanos);
     static void signalFunc(int sig);
-    static InternalThread* threadToSignal;
-    static pthread_mutex_t threadSignalMutex;
     static void* startIdleThread(ThreadManager* threadManager);
     LockManager* lockManager;
+    SchedulerStats stats;
+    pthread_mutex_t statsMutex;
+    TickTimingStats timing;
+    void recordSwitch(long long nanos);
+    void recordTiming(long long tickNanos, long long sliceNanos);
+    StatsPublisher* statsPage;
+    void recordTick(bool idle,
+                    bool continued,
+                    long long schedulerNanos,
+                    long long switchNanos,
+                    bool preempted);
 
    public:
     static ThreadManager* getInstance();
     static void shutdown();
     void sleepCurrentThread();
+    void blockCurrentThread(int wakeTick);
+    void setPriority(Thread* thread, int priority);
+    void lockPolicy(sigset_t* oldSet);
+    void unlockPolicy(sigset_t* oldSet);
+    void changePriority(Thread* thread, int priority);
+    void waitOn(WaitQueue* queue, sigset_t* oldSet);
+    void blockOn(WaitQueue* queue);
+    void blockOn(WaitQueue* queue, int wakeTick);
+    void blockOn(WaitQueue* queue, int wakeTick, const char* lockId);
+    void parkCurrentThread();
+    Thread* wakeFrom(WaitQueue* queue);
     void waitForFinish();
     static void destroyThreadManager();
-    shared_ptr<InternalThread> currentThread();
+    InternalThread* currentThread();
     int currentTick();
-    void createThread(Thread* thread);
-    void start();
+    bool createThread(Thread* thread);
+    bool createThread(Thread* thread, const RealtimeParams* params);
+    static void forgetThread(Thread* thread);
+    int waitForNextPeriod();
+    Thread* joinAny(Thread** threads, int count);
+    void start(const char* policyName);
+    static void copyStats(SchedulerStats* out);
+    static void copyTiming(TickTimingStats* out);
+    static void setOverrunWarning(int overrunMicros);
 };
 }  // namespace Threading
 
@@ -0,0 +1,134 @@
+#include "ThreadRegistry.h"
+
+#include <string.h>
+
+using namespace Threading;
+
+static_assert(REGISTRY_CHUNK_SIZE * REGISTRY_CHUNKS <= 1 << SLOT_INDEX_BITS,
+              "every registry index must fit in a slot");
+
+static int indexOf(int slot) {
+    return slot & SLOT_INDEX_MASK;
+}
+
+static int generationOf(int slot) {
+    return slot >> SLOT_INDEX_BITS;
+}
+
+ThreadRegistry::ThreadRegistry() {
+    pthread_mutex_init(&slotMutex, NULL);
+    count = 0;
+    memset(chunks, 0, sizeof(chunks));
+}
+
+// Released threads belong to whoever released them until they are recycled.
+ThreadRegistry::~ThreadRegistry() {
+    int used = count;
+    for (int index = 0; index < used; index++) {
+        delete entryAt(index)->thread.load();
+    }
+    for (vector<InternalThread*>::iterator spare = spares.begin();
+         spare != spares.end(); spare++) {
+        delete *spare;
+    }
+    for (int x = 0; x < REGISTRY_CHUNKS; x++) {
+        delete[] chunks[x];
+    }
+    pthread_mutex_destroy(&slotMutex);
+}
+
+ThreadRegistry::Entry* ThreadRegistry::entryAt(int index) {
+    return &chunks[index / REGISTRY_CHUNK_SIZE][index % REGISTRY_CHUNK_SIZE];
+}
+
+// Reuses the index of the last thread released, if any. Returns NULL,
+// leaving the thread without a slot, once every index is in use.
+InternalThread* ThreadRegistry::add(Thread* thread) {
+    pthread_mutex_lock(&slotMutex);
+    int index = count;
+    if (!freeIndexes.empty()) {
+        index = freeIndexes.back();
+        freeIndexes.pop_back();
+    } else {
+        int chunk = index / REGISTRY_CHUNK_SIZE;
+        if (chunk == REGISTRY_CHUNKS) {
+            pthread_mutex_unlock(&slotMutex);
+            return NULL;
+        }
+        if (chunks[chunk] == NULL) {
+            chunks[chunk] = new Entry[REGISTRY_CHUNK_SIZE];
+            for (int x = 0; x < REGISTRY_CHUNK_SIZE; x++) {
+                chunks[chunk][x].thread.store(NULL, memory_order_relaxed);
+                chunks[chunk][x].generation.store(0, memory_order_relaxed);
+            }
+        }
+    }
+    Entry* entry = entryAt(index);
+    int slot = entry->generation.load(memory_order_relaxed) << SLOT_INDEX_BITS |
+               index;
+    InternalThread* internalThread;
+    if (spares.empty()) {
+        internalThread = new InternalThread(thread->func, thread->arg, thread);
+    } else {
+        internalThread = spares.back();
+        spares.pop_back();
+        internalThread->reuse(thread->func, thread->arg, thread);
+    }
+    internalThread->setSequence(slot);
+    thread->slot = slot;
+    // Publishes the entry, and the chunk it is in, to lookups.
+    entry->thread.store(internalThread, memory_order_release);
+    if (index == count)
+        count.store(index + 1, memory_order_release);
+    pthread_mutex_unlock(&slotMutex);
+    return internalThread;
+}
+
+// A thread that was never added has no slot, or one that belongs to another
+// thread.
+InternalThread* ThreadRegistry::find(Thread* thread) {
+    if (thread == NULL)
+        return NULL;
+    InternalThread* internalThread = at(thread->slot);
+    if (internalThread == NULL ||
+        internalThread->getExternalThread() != thread)
+        return NULL;
+    return internalThread;
+}
+
+// The entry is read before its generation, which changes before the entry is
+// reused, so a slot from an earlier generation never finds the new thread.
+InternalThread* ThreadRegistry::at(int slot) {
+    int index = indexOf(slot);
+    if (slot < 0 || index >= count.load(memory_order_acquire))
+        return NULL;
+    Entry* entry = entryAt(index);
+    InternalThread* internalThread = entry->thread.load(memory_order_acquire);
+    if (entry->generation.load(memory_order_relaxed) != generationOf(slot))
+        return NULL;
+    return internalThread;
+}
+
+// Returns NULL if the thread is not in the registry.
+InternalThread* ThreadRegistry::release(Thread* thread) {
+    pthread_mutex_lock(&slotMutex);
+    InternalThread* internalThread = find(thread);
+    if (internalThread != NULL) {
+        int index = indexOf(thread->slot);
+        Entry* entry = entryAt(index);
+        entry->thread.store(NULL, memory_order_release);
+        entry->generation.store(
+            (generationOf(thread->slot) + 1) % SLOT_GENERATIONS,
+            memory_order_relaxed);
+        freeIndexes.push_back(index);
+        thread->slot = NO_THREAD_SLOT;
+    }
+    pthread_mutex_unlock(&slotMutex);
+    return internalThread;
+}
+
+void ThreadRegistry::recycle(InternalThread* thread) {
+    pthread_mutex_lock(&slotMutex);
+    spares.push_back(thread);
+    pthread_mutex_unlock(&slotMutex);
+}
@@ -0,0 +1,55 @@
+#ifndef OS_THREADING_THREADREGISTRY_H
+#define OS_THREADING_THREADREGISTRY_H
+
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+#include "InternalThread.h"
+#include "Thread.h"
+#include "ThreadingConstants.h"
+
+using namespace std;
+
+namespace Threading {
+
+/**
+ * Owns the InternalThread of every created thread that has not been
+ * released. A thread's index in the registry and the generation of that index
+ * make up its slot, which is stored in the Thread itself, so finding its
+ * InternalThread is two array reads and a generation check. Chunks never
+ * move, so lookups take no lock.
+ *
+ * Releasing a thread hands its InternalThread to the caller and frees the
+ * index for the next thread added, under a new generation, so the slot of the
+ * released thread no longer finds anything. A thread must not be looked up
+ * while it is being released. Once nothing uses the InternalThread any more
+ * it can be recycled, and the next thread added runs on it instead of a new
+ * one. Adding, releasing and recycling are serialized by a mutex of their
+ * own.
+ */
+class ThreadRegistry {
+   public:
+    ThreadRegistry();
+    ~ThreadRegistry();
+    InternalThread* add(Thread* thread);
+    InternalThread* find(Thread* thread);
+    InternalThread* at(int slot);
+    InternalThread* release(Thread* thread);
+    void recycle(InternalThread* thread);
+
+   private:
+    typedef struct Entry {
+        atomic<InternalThread*> thread;
+        atomic<int> generation;
+    } Entry;
+
+    Entry* entryAt(int index);
+    pthread_mutex_t slotMutex;
+    atomic<int> count;
+    vector<int> freeIndexes;
+    vector<InternalThread*> spares;
+    Entry* chunks[REGISTRY_CHUNKS];
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_THREADREGISTRY_H
@@ -0,0 +1,228 @@
+#include "ThreadTable.h"
+#include <string.h>
+#include <climits>
+#include "ThreadingConstants.h"
+
+using namespace Threading;
+
+// The wake tick of a thread that waits without a deadline, so that sweeps for
+// due ticks pass it over.
+static const int NO_DEADLINE = INT_MAX;
+
+static int deadlineOf(int wakeTick) {
+    return wakeTick == NO_WAKE_TICK ? NO_DEADLINE : wakeTick;
+}
+
+ThreadTable::ThreadTable() {
+    memset(stateCounts, 0, sizeof(stateCounts));
+    memset(readyByPriority, 0, sizeof(readyByPriority));
+    dueTick = -1;
+    kernels = bestScanKernels();
+}
+
+// A row found through a slot is checked against the thread, as the registry
+// hands the index of a released thread to the next one added.
+int ThreadTable::rowOf(Thread* thread) {
+    if (thread->slot == NO_THREAD_SLOT)
+        return -1;
+    unsigned int index = thread->slot & SLOT_INDEX_MASK;
+    if (index >= rows.size())
+        return -1;
+    int row = rows[index];
+    return row != -1 && threads[row] == thread ? row : -1;
+}
+
+// Adds amount to the counts the row is part of.
+void ThreadTable::tally(int row, int amount) {
+    stateCounts[state[row]] += amount;
+    int level = effectivePriority[row] - MIN_PRI;
+    if (state[row] == RUN_READY && level >= 0 &&
+        level < MAX_PRI - MIN_PRI + 1)
+        readyByPriority[level] += amount;
+}
+
+void ThreadTable::setState(int row, RunState runState, int wakeTick) {
+    tally(row, -1);
+    state[row] = runState;
+    this->wakeTick[row] = wakeTick;
+    tally(row, 1);
+    if (wakeTick != NO_DEADLINE)
+        deadlines.push(wakeTick);
+}
+
+// Whether a wake tick set may be due by currentTick. Both sweeps of a tick
+// ask, so the answer is kept for the tick.
+bool ThreadTable::due(int currentTick) {
+    while (!deadlines.empty() && deadlines.top() <= currentTick) {
+        deadlines.pop();
+        dueTick = currentTick;
+    }
+    return dueTick == currentTick;
+}
+
+void ThreadTable::add(Thread* thread) {
+    if (thread->slot == NO_THREAD_SLOT || rowOf(thread) != -1)
+        return;
+    unsigned int index = thread->slot & SLOT_INDEX_MASK;
+    if (index >= rows.size())
+        rows.resize(index + 1, -1);
+    rows[index] = threads.size();
+    threads.push_back(thread);
+    effectivePriority.push_back(thread->priority);
+    basePriority.push_back(thread->priority);
+    state.push_back(RUN_READY);
+    wakeTick.push_back(NO_DEADLINE);
+    blockedOn.push_back(NULL);
+    donated.push_back(false);
+    tally(threads.size() - 1, 1);
+}
+
+void ThreadTable::remove(Thread* thread) {
+    int row = rowOf(thread);
+    if (row == -1)
+        return;
+    tally(row, -1);
+    int last = threads.size() - 1;
+    if (row != last) {
+        threads[row] = threads[last];
+        effectivePriority[row] = effectivePriority[last];
+        basePriority[row] = basePriority[last];
+        state[row] = state[last];
+        wakeTick[row] = wakeTick[last];
+        blockedOn[row] = blockedOn[last];
+        donated[row] = donated[last];
+        rows[threads[row]->slot & SLOT_INDEX_MASK] = row;
+    }
+    threads.pop_back();
+    effectivePriority.pop_back();
+    basePriority.pop_back();
+    state.pop_back();
+    wakeTick.pop_back();
+    blockedOn.pop_back();
+    donated.pop_back();
+    rows[thread->slot & SLOT_INDEX_MASK] = -1;
+}
+
+// A donation only changes the effective priority; the base priority is the
+// one the thread was created with or last set for itself, and what it goes
+// back to once nothing is donated to it.
+void ThreadTable::setPriority(Thread* thread, int priority, bool base) {
+    int row = rowOf(thread);
+    if (row == -1)
+        return;
+    tally(row, -1);
+    effectivePriority[row] = priority;
+    tally(row, 1);
+    if (base)
+        basePriority[row] = priority;
+}
+
+void ThreadTable::setReady(Thread* thread) {
+    int row = rowOf(thread);
+    if (row == -1)
+        return;
+    setState(row, RUN_READY, NO_DEADLINE);
+    blockedOn[row] = NULL;
+}
+
+void ThreadTable::setSleeping(Thread* thread, int wakeTick) {
+    int row = rowOf(thread);
+    if (row == -1)
+        return;
+    setState(row, RUN_SLEEPING, wakeTick);
+    blockedOn[row] = NULL;
+}
+
+// wakeTick is the deadline of a timed wait, NO_WAKE_TICK if there is none.
+void ThreadTable::setBlocked(Thread* thread,
+                             int wakeTick,
+                             const char* lockId) {
+    int row = rowOf(thread);
+    if (row == -1)
+        return;
+    setState(row, RUN_BLOCKED, deadlineOf(wakeTick));
+    blockedOn[row] = lockId;
+}
+
+// Sleepers are woken by the scheduling policy, which does not report it, so
+// the table catches up by itself. Returns how many threads woke up.
+int ThreadTable::wakeSleepers(int currentTick) {
+    if (!due(currentTick))
+        return 0;
+    int rowCount = threads.size();
+    selected.resize(rowCount);
+    int woken =
+        kernels->selectAtMost(wakeTick.data(), state.data(), RUN_SLEEPING,
+                              rowCount, currentTick, selected.data());
+    for (int x = 0; x < woken; x++) {
+        setState(selected[x], RUN_READY, NO_DEADLINE);
+    }
+    return woken;
+}
+
+// Adds the threads whose timed wait ran out by currentTick to expired. They
+// stay blocked until they are woken.
+void ThreadTable::expiredWaits(int currentTick, vector<Thread*>* expired) {
+    if (!due(currentTick))
+        return;
+    int rowCount = threads.size();
+    selected.resize(rowCount);
+    int due =
+        kernels->selectAtMost(wakeTick.data(), state.data(), RUN_BLOCKED,
+                              rowCount, currentTick, selected.data());
+    for (int x = 0; x < due; x++) {
+        expired->push_back(threads[selected[x]]);
+    }
+}
+
+// The lock a blocked thread waits to take, NULL if it waits for something
+// else or is not blocked.
+const char* ThreadTable::blockedOnLock(Thread* thread) {
+    int row = rowOf(thread);
+    return row == -1 ? NULL : blockedOn[row];
+}
+
+// Called before the first donation to a thread is applied, so its current
+// priority is the one to give back.
+void ThreadTable::markDonated(Thread* thread) {
+    int row = rowOf(thread);
+    if (row == -1 || donated[row])
+        return;
+    basePriority[row] = thread->priority;
+    donated[row] = true;
+}
+
+// Whether a donation to the thread is in effect, and if so the priority it
+// had before.
+bool ThreadTable::donatedFrom(Thread* thread, int* priority) {
+    int row = rowOf(thread);
+    if (row == -1 || !donated[row])
+        return false;
+    *priority = basePriority[row];
+    return true;
+}
+
+void ThreadTable::clearDonation(Thread* thread) {
+    int row = rowOf(thread);
+    if (row != -1)
+        donated[row] = false;
+}
+
+int ThreadTable::count(RunState runState) {
+    return stateCounts[runState];
+}
+
+// counts has a slot per priority from MIN_PRI to MAX_PRI and is added to.
+void ThreadTable::countReadyByPriority(int* counts) {
+    for (int level = 0; level < MAX_PRI - MIN_PRI + 1; level++) {
+        counts[level] += readyByPriority[level];
+    }
+}
+
+int ThreadTable::size() {
+    return threads.size();
+}
+
+bool ThreadTable::contains(Thread* thread) {
+    return rowOf(thread) != -1;
+}
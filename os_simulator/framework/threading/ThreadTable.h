@@ -0,0 +1,88 @@
+#ifndef OS_THREADING_THREADTABLE_H
+#define OS_THREADING_THREADTABLE_H
+
+#include <stdint.h>
+#include <functional>
+#include <queue>
+#include <vector>
+#include "ScanKernels.h"
+#include "Thread.h"
+
+using namespace std;
+
+namespace Threading {
+
+/**
+ * What the ThreadManager last learned about a thread. A sleeping thread is
+ * ready again at its wake tick; a blocked one only when it is woken.
+ */
+typedef enum RunState {
+    RUN_READY = 0,
+    RUN_SLEEPING = 1,
+    RUN_BLOCKED = 2
+} RunState;
+
+/**
+ * The scheduling state of every live thread, one row per thread and one
+ * array per field, so passes over all threads read only the fields they need
+ * from contiguous memory. Rows are packed: removing a thread moves the last
+ * row into its place. A thread's row is found through the registry index in
+ * its slot. Like the wait queues, the table is only touched with the
+ * ThreadManager's policy mutex held.
+ *
+ * The counts by state and of ready threads by priority are kept up to date as
+ * rows change, so reading them costs nothing. The sweeps for due wake ticks
+ * use the fastest ScanKernels the CPU supports, and only run on ticks that a
+ * deadline was set for.
+ *
+ * The ThreadManager expires timed waits from the wake ticks, and the
+ * LockManager follows chains of donations through the lock each thread waits
+ * for and gives back the priority it had before them. Sleepers are woken by
+ * the scheduling policy; the table only follows along for the counters.
+ */
+class ThreadTable {
+   public:
+    ThreadTable();
+    void add(Thread* thread);
+    void remove(Thread* thread);
+    void setPriority(Thread* thread, int priority, bool base);
+    void setReady(Thread* thread);
+    void setSleeping(Thread* thread, int wakeTick);
+    void setBlocked(Thread* thread, int wakeTick, const char* lockId);
+    int wakeSleepers(int currentTick);
+    void expiredWaits(int currentTick, vector<Thread*>* expired);
+    const char* blockedOnLock(Thread* thread);
+    void markDonated(Thread* thread);
+    bool donatedFrom(Thread* thread, int* priority);
+    void clearDonation(Thread* thread);
+    int count(RunState runState);
+    void countReadyByPriority(int* counts);
+    int size();
+    bool contains(Thread* thread);
+
+   private:
+    // Row of each registry index, -1 for none.
+    vector<int> rows;
+    vector<Thread*> threads;
+    vector<int> effectivePriority;
+    vector<int> basePriority;
+    vector<uint8_t> state;
+    vector<int> wakeTick;
+    vector<const char*> blockedOn;
+    vector<uint8_t> donated;
+    vector<int> selected;
+    int stateCounts[RUN_BLOCKED + 1];
+    int readyByPriority[MAX_PRI - MIN_PRI + 1];
+    // Wake ticks set since they were last swept for, and the last tick a
+    // sweep was due on.
+    priority_queue<int, vector<int>, greater<int>> deadlines;
+    int dueTick;
+    const ScanKernels* kernels;
+    int rowOf(Thread* thread);
+    void tally(int row, int amount);
+    void setState(int row, RunState runState, int wakeTick);
+    bool due(int currentTick);
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_THREADTABLE_H
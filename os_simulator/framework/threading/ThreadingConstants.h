@@ -7,5 +7,35 @@ namespace Threading {
 static const int MICROSECONDS_TICK = 50000;
 static const struct timespec THREAD_JOIN_TIMEOUT = {0,
                                                     MICROSECONDS_TICK * 1000};
+// How many ticks a replayed slice may take to get where it ended in the
+// recording before the replay gives up on it and preempts the thread like a
+// timed slice. Only a replay that has diverged gets there.
+static const int REPLAY_SLICE_TICKS = 4;
+// How long a replay sleeps between looks for a thread the recording had
+// created by now but the replayed workload has not yet.
+static const int REPLAY_POLL_MICROSECONDS = 1000;
+// Call limit of a thread that may make as many calls as it likes.
+static const long NO_CALL_LIMIT = -1;
+// How many lock holders a waiting thread donates its priority through when
+// they are themselves waiting for locks.
+static const int MAX_DONATION_DEPTH = 8;
+// Longest thread name, with its null character, stored inside a thread record
+// rather than interned, and how many records a slab of the arena holds.
+static const int THREAD_NAME_CAPACITY = 32;
+static const int THREADS_PER_SLAB = 64;
+// Events that can wait in the ThreadManager's queue at once, a power of two.
+// A thread that finds it full drains it and tries again.
+static const int EVENT_QUEUE_CAPACITY = 1024;
+// Slot of a thread that has not been created, and how the registry of
+// created threads is split into chunks, which bounds how many threads can be
+// alive at once in one run of the simulator. A slot holds the thread's index
+// in the registry in its low bits and, above them, the generation of that
+// index, which changes each time the index is reused.
+static const int NO_THREAD_SLOT = -1;
+static const int REGISTRY_CHUNK_SIZE = 1024;
+static const int REGISTRY_CHUNKS = 4096;
+static const int SLOT_INDEX_BITS = 22;
+static const int SLOT_INDEX_MASK = (1 << SLOT_INDEX_BITS) - 1;
+static const int SLOT_GENERATIONS = 1 << (31 - SLOT_INDEX_BITS);
 }  // namespace Threading
 #endif  // OS_THREADING_THREADINGCONSTANTS_H
@@ -0,0 +1,59 @@
+#include "WaitQueue.h"
+
+using namespace Threading;
+
+WaitQueue::WaitQueue() {
+    nextSequence = 0;
+}
+
+void WaitQueue::push(Thread* thread) {
+    if (positions.count(thread) == 1)
+        return;
+    Waiter waiter = {thread->priority, nextSequence++, thread};
+    positions[thread] = waiters.insert(waiter).first;
+}
+
+Thread* WaitQueue::pop() {
+    if (waiters.empty())
+        return NULL;
+    Thread* thread = waiters.begin()->thread;
+    positions.erase(thread);
+    waiters.erase(waiters.begin());
+    return thread;
+}
+
+Thread* WaitQueue::top() {
+    if (waiters.empty())
+        return NULL;
+    return waiters.begin()->thread;
+}
+
+bool WaitQueue::remove(Thread* thread) {
+    map<Thread*, set<Waiter, WaiterOrder>::iterator>::iterator found =
+        positions.find(thread);
+    if (found == positions.end())
+        return false;
+    waiters.erase(found->second);
+    positions.erase(found);
+    return true;
+}
+
+// A waiter keeps its place in line among threads of its new priority.
+void WaitQueue::priorityChanged(Thread* thread) {
+    map<Thread*, set<Waiter, WaiterOrder>::iterator>::iterator found =
+        positions.find(thread);
+    if (found == positions.end())
+        return;
+    Waiter waiter = *found->second;
+    waiters.erase(found->second);
+    waiter.priority = thread->priority;
+    found->second = waiters.insert(waiter).first;
+}
+
+bool WaitQueue::empty() {
+    return waiters.empty();
+}
+
+int WaitQueue::size() {
+    return waiters.size();
+}
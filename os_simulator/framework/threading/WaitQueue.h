@@ -0,0 +1,50 @@
+#ifndef OS_THREADING_WAITQUEUE_H
+#define OS_THREADING_WAITQUEUE_H
+
+#include <map>
+#include <set>
+#include "Thread.h"
+
+using namespace std;
+
+namespace Threading {
+
+/**
+ * Threads blocked on a simulator object such as a lock, highest priority
+ * first and in arrival order within a priority. A queue is only touched with
+ * the ThreadManager's policy mutex held, which also covers priority changes of
+ * the threads in it.
+ */
+class WaitQueue {
+   public:
+    WaitQueue();
+    void push(Thread* thread);
+    Thread* pop();
+    Thread* top();
+    bool remove(Thread* thread);
+    void priorityChanged(Thread* thread);
+    bool empty();
+    int size();
+
+   private:
+    typedef struct Waiter {
+        int priority;
+        long sequence;
+        Thread* thread;
+    } Waiter;
+
+    struct WaiterOrder {
+        bool operator()(const Waiter& first, const Waiter& second) const {
+            if (first.priority != second.priority)
+                return first.priority > second.priority;
+            return first.sequence < second.sequence;
+        }
+    };
+
+    set<Waiter, WaiterOrder> waiters;
+    map<Thread*, set<Waiter, WaiterOrder>::iterator> positions;
+    long nextSequence;
+};
+}  // namespace Threading
+
+#endif  // OS_THREADING_WAITQUEUE_H
@@ -22,6 +22,24 @@ const char* createLock();
  */
 bool lock(const char* lockId);
 
+/**
+ * Locks a given lock only if it is free, without waiting.
+ * @param lockId The lock id of the lock to be locked.
+ * @return true if the lock was taken, false otherwise
+ */
+bool tryLock(const char* lockId);
+
+/**
+ * Locks a given lock like lock, but gives up once ticks ticks have passed. The
+ * thread does not run while it waits, and runs again on the tick the lock is
+ * handed to it or on the tick it gives up, whichever comes first.
+ * @param lockId The lock id of the lock to be locked.
+ * @param ticks How many ticks to wait at most; 0 waits not at all and a
+ * negative number waits as long as it takes.
+ * @return true if the lock was taken, false otherwise
+ */
+bool lockWithTimeout(const char* lockId, int ticks);
+
 /**
  * Unlocks a given lock, this allows another thread requesting the lock to
  * receive the lock. This function must be called if a lock is locked,
@@ -46,6 +64,16 @@ void destroyLock(const char* lockId);
  */
 bool isLocked(const char* lockId);
 
+/**
+ * Returns the thread holding a lock. A lock nobody else wants is taken and
+ * released without calling lockAttempted, lockAcquired or lockReleased, so
+ * this is the only way to learn who holds it.
+ * @param lockId The lock id of the lock to be checked.
+ * @return The thread holding the lock, or NULL if the lock is free, does not
+ * exist or is held by a thread outside the simulation.
+ */
+Thread* getLockHolder(const char* lockId);
+
 /**
  * Returns true if this lock currently exists regardless of state. If the lock
  * provided was created but never destroyed, this will return true. If the lock
@@ -55,6 +83,52 @@ bool isLocked(const char* lockId);
  */
 bool lockExists(const char* lockId);
 
+// Reader-writer locks share the ids of the locks above, and destroyLock,
+// isLocked and lockExists work on them too. lock and unlock do not, and the
+// callbacks below are not called for them: the framework does their priority
+// donation itself.
+
+/**
+ * Creates a reader-writer lock, which any number of threads can hold shared
+ * or a single thread can hold exclusive.
+ * @param preferWriters If true, no thread gets the lock shared while another
+ * waits to get it exclusive, so writers cannot starve. If false, threads get
+ * the lock shared whenever nobody holds it exclusive.
+ * @return A unique string that represents the lock.
+ */
+const char* createReadWriteLock(bool preferWriters);
+
+/**
+ * Locks a reader-writer lock shared, waiting while another thread holds it
+ * exclusive. A waiting thread donates its priority to the holder. A thread
+ * must not lock the same lock twice.
+ * @param lockId The lock id of the lock to be locked.
+ * @return true if successful, false otherwise
+ */
+bool lockShared(const char* lockId);
+
+/**
+ * Locks a reader-writer lock exclusive, waiting while any other thread holds
+ * it. A waiting thread donates its priority to every holder.
+ * @param lockId The lock id of the lock to be locked.
+ * @return true if successful, false otherwise
+ */
+bool lockExclusive(const char* lockId);
+
+/**
+ * Gives up a shared hold on a reader-writer lock.
+ * @param lockId The lock id of the lock to be unlocked.
+ * @return true if successful, false if the thread did not hold it shared.
+ */
+bool unlockShared(const char* lockId);
+
+/**
+ * Gives up an exclusive hold on a reader-writer lock.
+ * @param lockId The lock id of the lock to be unlocked.
+ * @return true if successful, false if the thread did not hold it exclusive.
+ */
+bool unlockExclusive(const char* lockId);
+
 #define _INCLUDED_FROM_LOCK_H
 #include "Lock.student.h"
 #undef _INCLUDED_FROM_LOCK_H
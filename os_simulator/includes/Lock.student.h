@@ -4,7 +4,9 @@
 
 // The functions below here are functions that are called by the framework when
 // an event happens. You can use them to modify your state when a lock is
-// manipulated.
+// manipulated. A lock that is free when a thread locks it, and that nobody
+// waits for when it is unlocked, does not reach lockAttempted, lockAcquired or
+// lockReleased; they only hear about locks other threads are waiting for.
 
 /**
  * This function is called right after createLock in order to notify anyone that
@@ -16,8 +18,8 @@
 void lockCreated(const char* lockId);
 
 /**
- * This function is called when an attempt is made on a lock but has not yet
- * been locked. This function is called synchronously during the locking
+ * This function is called when an attempt is made on a lock that is held by
+ * another thread. This function is called synchronously during the locking
  * process so you can be guaranteed the lock will not be acquired by the given
  * thread while in this function.
  *
@@ -0,0 +1,33 @@
+/**
+ * Record and replay of scheduling decisions. A recording captures which thread
+ * ran on every tick and how its slice ended. Replaying it makes the simulator
+ * repeat that interleaving. No slice is timed: a preempted slice ends once the
+ * thread has made as many calls into the simulator as it did in the recording,
+ * so a replay runs much faster than the recording.
+ *
+ * Both functions apply to the next call to startSystem only. The environment
+ * variables SIMULATOR_RECORD and SIMULATOR_REPLAY do the same for any program
+ * that does not call them.
+ */
+
+#ifndef OS_THREADING_REPLAY_H
+#define OS_THREADING_REPLAY_H
+
+/**
+ * Records the schedule of the next run into a binary file.
+ *
+ * @param path The file to write, it is replaced if it exists.
+ */
+void recordSchedule(const char* path);
+
+/**
+ * Replays a schedule written by recordSchedule during the next run. Threads
+ * are matched by creation order so the same workload must be run. Ticks where
+ * the scheduler would have chosen differently are counted as divergences in
+ * SchedulerStats.
+ *
+ * @param path The file to read.
+ */
+void replaySchedule(const char* path);
+
+#endif  // OS_THREADING_REPLAY_H
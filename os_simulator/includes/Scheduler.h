@@ -0,0 +1,238 @@
+/**
+ * Tunables and counters of the scheduling policies that can be selected with
+ * startSystem(const char*), and the real-time class that runs ahead of them.
+ * Tunables and counters belong to the simulator bound to the calling thread.
+ * Tunables apply from its next call to startSystem; counters describe the
+ * current run, or the last one after stopSystem.
+ */
+
+#ifndef OS_THREADING_SCHEDULER_H
+#define OS_THREADING_SCHEDULER_H
+
+#include "Thread.h"
+
+/**
+ * Tunables of the "priority-rr" policy. A thread keeps the CPU for a whole
+ * time slice unless a thread of higher priority becomes ready; only then do
+ * the threads of its priority take turns. The dispatcher lets a thread that is
+ * picked again run on without pausing and resuming it, so longer slices save
+ * context switches.
+ *
+ * @param sliceTicks Ticks in the time slice of each priority, indexed by
+ * priority - MIN_PRI, default 1 for every priority.
+ */
+typedef struct TimeSliceConfig {
+    int sliceTicks[MAX_PRI - MIN_PRI + 1];
+} TimeSliceConfig;
+
+/**
+ * Sets the tunables of the "priority-rr" policy.
+ *
+ * @param config The tunables to use from the next startSystem.
+ */
+void setTimeSliceConfig(const TimeSliceConfig* config);
+
+/**
+ * Tunables of the "cfs" policy. Every thread accumulates virtual runtime at a
+ * rate that falls as its priority rises, and the ready thread with the least
+ * virtual runtime runs next. Virtual runtime is measured in ticks run at
+ * DEFAULT_PRI.
+ *
+ * @param minGranularity Ticks a thread keeps the CPU before a thread with less
+ * virtual runtime can take over, default 1.
+ * @param wakeupPreemption Whether a thread that wakes up may take the CPU from
+ * a thread that has not used its minimum granularity yet, default true.
+ * @param wakeupGranularity How many ticks of virtual runtime a woken thread
+ * must be behind the running thread to preempt it, default 1.
+ */
+typedef struct FairShareConfig {
+    int minGranularity;
+    bool wakeupPreemption;
+    int wakeupGranularity;
+} FairShareConfig;
+
+/**
+ * Counters of the "cfs" policy.
+ *
+ * @param picks Ticks on which a thread was picked.
+ * @param totalLatency Ticks threads spent ready before being picked, summed
+ * over all picks.
+ * @param maxLatency Longest time a thread spent ready before being picked.
+ * @param wakeupPreemptions Picks where a woken thread cut the minimum
+ * granularity of the running thread short.
+ * @param fairness Jain's fairness index of the priority-weighted CPU time of
+ * every live thread that ran; 1 when each got exactly its share. Once the
+ * last of them ends it keeps the value it had before.
+ * @param vruntimeSpread Difference in virtual runtime between the ready
+ * threads furthest ahead and furthest behind, in ticks.
+ */
+typedef struct FairShareStats {
+    long picks;
+    long long totalLatency;
+    int maxLatency;
+    long wakeupPreemptions;
+    double fairness;
+    double vruntimeSpread;
+} FairShareStats;
+
+/**
+ * Sets the tunables of the "cfs" policy.
+ *
+ * @param config The tunables to use from the next startSystem.
+ */
+void setFairShareConfig(const FairShareConfig* config);
+
+/**
+ * Copies the counters of the "cfs" policy into stats. They describe the last
+ * run that used the policy and are all zero if none did.
+ *
+ * @param stats Where to copy the counters.
+ */
+void getFairShareStats(FairShareStats* stats);
+
+/**
+ * Most levels the "mlfq" policy supports.
+ */
+const int MLFQ_MAX_LEVELS = 8;
+
+/**
+ * Tunables of the "mlfq" policy. Threads start on level 0 and the first
+ * non-empty level runs first, round-robin within the level. A thread that uses
+ * its whole quantum moves down a level; a thread that wakes from a sleep, or
+ * yields before its quantum is over, moves up one. Thread priorities are
+ * ignored.
+ *
+ * @param levels Number of levels, default 3.
+ * @param quantum Ticks a thread runs before being demoted, per level, default
+ * 1, 2 and 4.
+ * @param agingInterval Every this many ticks all threads go back to level 0 so
+ * that none can starve, default 50; 0 turns aging off.
+ */
+typedef struct MlfqConfig {
+    int levels;
+    int quantum[MLFQ_MAX_LEVELS];
+    int agingInterval;
+} MlfqConfig;
+
+/**
+ * Counters of the "mlfq" policy.
+ *
+ * @param demotions Threads moved down a level for using a whole quantum.
+ * @param promotions Threads moved up a level for yielding early or waking up.
+ * @param agingPasses Times every thread was moved back to level 0.
+ * @param levelPicks Ticks on which a thread of each level was picked.
+ */
+typedef struct MlfqStats {
+    long demotions;
+    long promotions;
+    long agingPasses;
+    long levelPicks[MLFQ_MAX_LEVELS];
+} MlfqStats;
+
+/**
+ * Sets the tunables of the "mlfq" policy.
+ *
+ * @param config The tunables to use from the next startSystem.
+ */
+void setMlfqConfig(const MlfqConfig* config);
+
+/**
+ * Copies the counters of the "mlfq" policy into stats. They describe the last
+ * run that used the policy and are all zero if none did.
+ *
+ * @param stats Where to copy the counters.
+ */
+void getMlfqStats(MlfqStats* stats);
+
+/**
+ * Timing of a real-time thread, all in ticks. A job is released every period;
+ * it may run for budget ticks and must finish within deadline ticks of its
+ * release.
+ *
+ * @param period Ticks between two releases.
+ * @param budget Ticks a job may run, at most deadline.
+ * @param deadline Ticks after a release by which the job must be done, at most
+ * period; 0 means period.
+ */
+typedef struct RealtimeParams {
+    int period;
+    int budget;
+    int deadline;
+} RealtimeParams;
+
+/**
+ * Counters of the real-time class for the whole run.
+ *
+ * @param admitted Threads admitted by createRealtimeThread.
+ * @param rejected Threads turned away because they would not fit.
+ * @param jobs Jobs released.
+ * @param deadlineMisses Jobs that were not done by their deadline.
+ * @param throttles Jobs that used up their budget and had to wait for the
+ * next release.
+ * @param utilization Sum of budget / deadline of the admitted threads that
+ * have not terminated.
+ */
+typedef struct RealtimeStats {
+    long admitted;
+    long rejected;
+    long jobs;
+    long deadlineMisses;
+    long throttles;
+    double utilization;
+} RealtimeStats;
+
+/**
+ * Counters of a single real-time thread.
+ *
+ * @param jobs Jobs released.
+ * @param deadlineMisses Jobs that were not done by their deadline.
+ * @param throttles Jobs that used up their budget.
+ * @param maxLateness Most ticks a job finished after its deadline.
+ */
+typedef struct RealtimeThreadStats {
+    long jobs;
+    long deadlineMisses;
+    long throttles;
+    int maxLateness;
+} RealtimeThreadStats;
+
+/**
+ * Creates a thread in the real-time class, which runs earliest deadline first
+ * ahead of every thread of the scheduling policy. The thread is only admitted
+ * if the budget / deadline of all real-time threads adds up to at most 1, so
+ * every admitted thread can meet its deadlines. A job that uses up its budget
+ * is not run again before its next release.
+ *
+ * @param thread The thread to create, built as for createThread.
+ * @param params The timing of the thread.
+ * @return true if the thread was admitted and created, false otherwise.
+ */
+bool createRealtimeThread(Thread* thread, const RealtimeParams* params);
+
+/**
+ * Ends the current job of a real-time thread and stops executing until its
+ * next release. Other threads just give up the rest of the tick.
+ *
+ * @return The tick of the next release.
+ */
+int waitForNextPeriod();
+
+/**
+ * Copies the counters of the real-time class into stats. They describe the
+ * current run, or the last one after stopSystem.
+ *
+ * @param stats Where to copy the counters.
+ */
+void getRealtimeStats(RealtimeStats* stats);
+
+/**
+ * Copies the counters of one real-time thread into stats.
+ *
+ * @param thread A thread created with createRealtimeThread.
+ * @param stats Where to copy the counters.
+ * @return false if the thread is not a real-time thread of the current or the
+ * last run, or has been freed since.
+ */
+bool getRealtimeThreadStats(Thread* thread, RealtimeThreadStats* stats);
+
+#endif  // OS_THREADING_SCHEDULER_H
@@ -0,0 +1,57 @@
+/**
+ * Independent simulators in one process, so that experiments such as
+ * parameter sweeps can run side by side on several cores. Each simulator has
+ * its own threads and thread records, ticks, locks, synchronization objects,
+ * lists and maps, logger, the tunables and counters in Scheduler.h and the
+ * settings in Replay.h and StatsPage.h.
+ *
+ * Every other function of the simulator works on the simulator bound to the
+ * calling thread. Threads created in a simulator are bound to it. A thread
+ * that has not bound one uses the default simulator, which is all that
+ * programs that never call these functions see.
+ *
+ * The callbacks in Thread.student.h and Lock.student.h keep their state in
+ * globals, so one simulator at a time holds them: the first to start while no
+ * other does. It calls initializeCallback when it starts and shutdownCallback
+ * when it stops. Simulators that start in the meantime do not call the
+ * callbacks, and run the "cfs" policy if they ask for "priority-rr", which
+ * schedules through them.
+ */
+
+#ifndef OS_THREADING_SIMULATOR_H
+#define OS_THREADING_SIMULATOR_H
+
+typedef struct Simulator Simulator;
+
+/**
+ * Creates a simulator. Bind it with setCurrentSimulator, then use it as usual
+ * from startSystem to stopSystem; it can be started again after that.
+ *
+ * @return The new simulator.
+ */
+Simulator* createSimulator();
+
+/**
+ * Destroys a simulator, with its locks, synchronization objects, lists, maps
+ * and thread records. It must not be running, and no thread may use it
+ * afterwards.
+ *
+ * @param simulator A simulator returned by createSimulator.
+ */
+void destroySimulator(Simulator* simulator);
+
+/**
+ * Binds the calling thread to a simulator.
+ *
+ * @param simulator The simulator to use, or NULL for the default simulator.
+ */
+void setCurrentSimulator(Simulator* simulator);
+
+/**
+ * Returns the simulator bound to the calling thread.
+ *
+ * @return The simulator, the default simulator if none was bound.
+ */
+Simulator* getCurrentSimulator();
+
+#endif  // OS_THREADING_SIMULATOR_H
@@ -0,0 +1,145 @@
+/**
+ * Counters kept by the simulator about its own behavior. These are meant for
+ * tooling (benchmarks, stress runs) rather than for scheduling decisions.
+ */
+
+#ifndef OS_THREADING_STATS_H
+#define OS_THREADING_STATS_H
+
+#include "Thread.h"
+
+/**
+ * Scheduler counters for a single run of the simulator.
+ *
+ * @param ticks Ticks started by the idle thread.
+ * @param idleTicks Ticks on which no thread was ready to run.
+ * @param threadsCreated Threads handed to createThread.
+ * @param dispatches Slices given to a thread (starts and resumes).
+ * @param continuations Ticks on which the thread of the previous tick was
+ * picked again and ran on without being paused and resumed.
+ * @param preemptions Slices that ended with the thread being paused.
+ * @param schedulerNanos Wall-clock time spent choosing the next thread.
+ * @param switchNanos Wall-clock time spent starting, resuming and pausing
+ * threads.
+ * @param replayDivergences Ticks of a replay where the scheduler chose
+ * differently than the recording; the recording wins.
+ * @param readyThreads Threads ready to run at the start of the last tick,
+ * including the one that ran.
+ * @param sleepingThreads Threads waiting for a wake tick at the start of the
+ * last tick.
+ * @param blockedThreads Threads waiting for a lock, a synchronization object
+ * or another thread at the start of the last tick.
+ * @param readyByPriority readyThreads split up by priority, indexed by
+ * priority - MIN_PRI. Priorities the scheduler does not know about, such as
+ * those set by student callbacks, are not reflected.
+ */
+typedef struct SchedulerStats {
+    int ticks;
+    int idleTicks;
+    long threadsCreated;
+    long dispatches;
+    long continuations;
+    long preemptions;
+    long long schedulerNanos;
+    long long switchNanos;
+    long replayDivergences;
+    int readyThreads;
+    int sleepingThreads;
+    int blockedThreads;
+    int readyByPriority[MAX_PRI - MIN_PRI + 1];
+} SchedulerStats;
+
+/**
+ * Copies the counters of the running simulator into stats. After stopSystem
+ * the counters of the run that just finished are returned; they are reset by
+ * the next startSystem.
+ *
+ * @param stats Where to copy the counters.
+ */
+void getSchedulerStats(SchedulerStats* stats);
+
+// Buckets of a TickTimingStats histogram.
+const int TIMING_BUCKETS = 24;
+
+/**
+ * Wall-clock timing of the idle thread, which is meant to start a tick every
+ * MICROSECONDS_TICK but only loosely keeps to it. Histograms count durations
+ * by powers of two microseconds: bucket 0 holds durations under 2 us, bucket b
+ * those from 2^b up to 2^(b+1) us, and the last bucket everything longer.
+ *
+ * @param ticks Ticks timed.
+ * @param nominalNanos How long a tick is meant to take.
+ * @param driftNanos How much longer all timed ticks took than they were meant
+ * to, negative if slices that ended early (yields, exits, replays) outweigh
+ * overruns.
+ * @param overruns Ticks that took longer than they were meant to.
+ * @param overrunNanos How much longer those ticks took, summed.
+ * @param maxOverrunNanos The longest overrun.
+ * @param overrunWarnings Overruns over the threshold set with
+ * setTickOverrunWarning, each of which was logged.
+ * @param tickHistogram Wall-clock length of ticks.
+ * @param switchHistogram Time taken to start, resume or pause a thread, each
+ * one counted separately.
+ * @param overheadHistogram Time per tick the idle thread spent on anything
+ * but waiting for the slice of a thread or sleeping through an idle tick.
+ */
+typedef struct TickTimingStats {
+    long ticks;
+    long long nominalNanos;
+    long long driftNanos;
+    long overruns;
+    long long overrunNanos;
+    long long maxOverrunNanos;
+    long overrunWarnings;
+    long tickHistogram[TIMING_BUCKETS];
+    long switchHistogram[TIMING_BUCKETS];
+    long overheadHistogram[TIMING_BUCKETS];
+} TickTimingStats;
+
+/**
+ * Copies the timing of the running simulator into stats. Like
+ * getSchedulerStats, after stopSystem the timing of the run that just
+ * finished is returned.
+ *
+ * @param stats Where to copy the timing.
+ */
+void getTickTimingStats(TickTimingStats* stats);
+
+/**
+ * Logs a warning for every tick that takes longer than it is meant to by more
+ * than overrunMicros. Takes effect right away and lasts until changed.
+ *
+ * @param overrunMicros The threshold, 0 (the default) for no warnings.
+ */
+void setTickOverrunWarning(int overrunMicros);
+
+/**
+ * Contention counters of a lock or reader-writer lock, kept for as long as the
+ * lock exists.
+ *
+ * @param acquisitions Times the lock was taken, shared or exclusive.
+ * @param sharedAcquisitions Times a reader-writer lock was taken shared.
+ * @param contentions Acquisitions that had to wait for the lock.
+ * @param waitTicks Ticks spent waiting, summed over all contentions.
+ * @param maxWaitTicks Longest wait for the lock.
+ * @param donations Priority raises of holders caused by waiters of the lock.
+ */
+typedef struct LockStats {
+    long acquisitions;
+    long sharedAcquisitions;
+    long contentions;
+    long long waitTicks;
+    int maxWaitTicks;
+    long donations;
+} LockStats;
+
+/**
+ * Copies the contention counters of a lock into stats.
+ *
+ * @param lockId The lock id of a lock or reader-writer lock.
+ * @param stats Where to copy the counters.
+ * @return false if the lock does not exist.
+ */
+bool getLockStats(const char* lockId, LockStats* stats);
+
+#endif  // OS_THREADING_STATS_H
@@ -0,0 +1,105 @@
+/**
+ * Live scheduler counters in a shared memory page, for watching a run from
+ * another process without stopping it or turning on verbose logs. The idle
+ * thread updates the page at the end of every tick; readers never hold it up.
+ *
+ * publishStats applies to the next call to startSystem only. The environment
+ * variable SIMULATOR_STATS does the same for any program that does not call
+ * it. The page is left in place when the run ends, so the last counters can
+ * still be read, and is replaced by the next run published under its name.
+ */
+
+#ifndef OS_THREADING_STATSPAGE_H
+#define OS_THREADING_STATSPAGE_H
+
+#include <stdint.h>
+#include <atomic>
+#include "Thread.h"
+
+// Layout version of StatsPage, changed whenever its fields change.
+const uint32_t STATS_PAGE_VERSION = 1;
+
+/**
+ * The counters of a StatsPage as of the end of one tick.
+ *
+ * @param running 1 while the run is going, 0 once it has ended.
+ * @param tick The tick that just ended.
+ * @param ticksPerSecond Ticks started per second of wall-clock time, measured
+ * over the last second or so.
+ * @param readyThreads Threads ready to run at the start of the tick.
+ * @param sleepingThreads Threads waiting for a wake tick.
+ * @param blockedThreads Threads waiting for a lock, a synchronization object
+ * or another thread.
+ * @param contextSwitches Slices given to a thread (starts and resumes).
+ * @param preemptions Slices that ended with the thread being paused.
+ * @param readyByPriority readyThreads split up by priority, indexed by
+ * priority - MIN_PRI.
+ * @param lockContentions Acquisitions of any lock of the simulator that had to
+ * wait for it, since the simulator was created.
+ * @param lockWaitTicks Ticks spent waiting for locks, summed over all
+ * contentions.
+ */
+typedef struct StatsPageCounters {
+    int running;
+    int tick;
+    double ticksPerSecond;
+    int readyThreads;
+    int sleepingThreads;
+    int blockedThreads;
+    long contextSwitches;
+    long preemptions;
+    int readyByPriority[MAX_PRI - MIN_PRI + 1];
+    long lockContentions;
+    long long lockWaitTicks;
+} StatsPageCounters;
+
+/**
+ * The shared page. sequence is odd while the counters are being written, so a
+ * copy of them is only consistent if sequence was the same even number before
+ * and after it was taken; readStatsPage does this.
+ *
+ * @param magic "OSSTATS" and a null character.
+ * @param version STATS_PAGE_VERSION of the writer.
+ * @param sequence Bumped before and after every update.
+ * @param counters The counters.
+ */
+typedef struct StatsPage {
+    char magic[8];
+    uint32_t version;
+    std::atomic<uint32_t> sequence;
+    StatsPageCounters counters;
+} StatsPage;
+
+/**
+ * Publishes the counters of the next run in /dev/shm/name.
+ *
+ * @param name The file name of the page, without a directory.
+ */
+void publishStats(const char* name);
+
+/**
+ * Maps a page published under name for reading.
+ *
+ * @param name The name given to publishStats or SIMULATOR_STATS.
+ * @return The page, or NULL if there is none or it was written by a different
+ * version.
+ */
+const StatsPage* mapStatsPage(const char* name);
+
+/**
+ * Copies a consistent set of counters out of a page, retrying while the
+ * writer is in the middle of an update.
+ *
+ * @param page A page returned by mapStatsPage.
+ * @param counters Where to copy the counters.
+ */
+void readStatsPage(const StatsPage* page, StatsPageCounters* counters);
+
+/**
+ * Unmaps a page returned by mapStatsPage.
+ *
+ * @param page The page, may be NULL.
+ */
+void unmapStatsPage(const StatsPage* page);
+
+#endif  // OS_THREADING_STATSPAGE_H
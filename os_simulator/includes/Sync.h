@@ -0,0 +1,78 @@
+#ifndef FRAMEWORK_SYNC_H
+#define FRAMEWORK_SYNC_H
+
+#include "Lock.h"
+
+// Condition variables and counting semaphores for simulated threads. Like
+// locks they are identified by a unique string. A thread that has to wait is
+// taken off the CPU until it is woken, and the highest priority waiter is
+// woken first.
+
+/**
+ * Creates a condition variable.
+ * @return A unique string that represents the condition variable.
+ */
+const char* createCondition();
+
+/**
+ * Releases the lock and waits until the condition is signaled, then locks the
+ * lock again before returning. The condition may no longer hold by the time
+ * the lock is back, so wait in a loop that checks it.
+ * @param conditionId The condition to wait for.
+ * @param lockId A lock held by the current thread.
+ * @return true once woken and holding the lock again, false if the condition
+ * does not exist, the caller does not hold the lock or the caller is not a
+ * simulated thread.
+ */
+bool waitCondition(const char* conditionId, const char* lockId);
+
+/**
+ * Wakes the highest priority thread waiting for the condition, if any.
+ * @param conditionId The condition to signal.
+ * @return true if the condition exists, false otherwise.
+ */
+bool signalCondition(const char* conditionId);
+
+/**
+ * Wakes every thread waiting for the condition.
+ * @param conditionId The condition to broadcast.
+ * @return true if the condition exists, false otherwise.
+ */
+bool broadcastCondition(const char* conditionId);
+
+/**
+ * Destroys a condition variable. Threads still waiting for it are woken.
+ * @param conditionId The condition to destroy.
+ */
+void destroyCondition(const char* conditionId);
+
+/**
+ * Creates a counting semaphore.
+ * @param value The initial count, at least 0.
+ * @return A unique string that represents the semaphore.
+ */
+const char* createSemaphore(int value);
+
+/**
+ * Takes one from the count of the semaphore, waiting until it is above 0.
+ * @param semaphoreId The semaphore to wait for.
+ * @return true once taken, false if the semaphore does not exist or was
+ * destroyed while waiting.
+ */
+bool semaphoreWait(const char* semaphoreId);
+
+/**
+ * Adds one to the count of the semaphore. If threads are waiting the highest
+ * priority one takes it right away.
+ * @param semaphoreId The semaphore to post.
+ * @return true if the semaphore exists, false otherwise.
+ */
+bool semaphorePost(const char* semaphoreId);
+
+/**
+ * Destroys a semaphore. Threads still waiting for it are woken and fail.
+ * @param semaphoreId The semaphore to destroy.
+ */
+void destroySemaphore(const char* semaphoreId);
+
+#endif  // FRAMEWORK_SYNC_H
@@ -18,6 +18,10 @@ const int MIN_PRI = 1;
 const int MAX_PRI = 10;
 const int DEFAULT_PRI = 5;
 
+// Wake tick of a thread that stays blocked until it is made ready again, such
+// as a thread waiting for a lock.
+const int NO_WAKE_TICK = -1;
+
 /**
  * Represents a thread.
  *
@@ -31,6 +35,8 @@ const int DEFAULT_PRI = 5;
  * @param state Current state of the thread
  * @param originalPriority Priority thread was created with, used for priority
  * donation.
+ * @param slot Where the framework keeps the thread once it is created, do not
+ * change.
  */
 typedef struct Thread {
     char* name;
@@ -39,6 +45,7 @@ typedef struct Thread {
     void* arg;
     State state;
     int originalPriority;
+    int slot;
 } Thread;
 
 // These functions are available for you to to call or used to run the tests.
@@ -48,6 +55,16 @@ typedef struct Thread {
  */
 void startSystem();
 
+/**
+ * Starts the simulator like startSystem but schedules with the named policy.
+ * "priority-rr" is the default policy, which schedules with nextThreadToRun
+ * and the thread callbacks. An unknown name is logged and the default policy
+ * is used instead.
+ *
+ * @param policyName The name of the scheduling policy to use.
+ */
+void startSystem(const char* policyName);
+
 /**
  * Stops the simulator waiting for all threads to finish before returning. This
  * is a synchronous operation and blocks until all threads are finished.
@@ -56,11 +73,16 @@ void stopSystem();
 
 /**
  * Creates a thread in the simulator so that it can be returned by
- * nextThreadToRun. This makes the simulator know the thread exists.
+ * nextThreadToRun. This makes the simulator know the thread exists. The
+ * scheduler is told about it (threadReady is called) before the next thread is
+ * picked; the caller does not wait for that. A few million threads can be
+ * alive at once, counting those that have ended but were not freed with
+ * freeThread; past that the thread is logged and not created.
  *
  * @param thread The thread to create in the simulator.
+ * @return Whether the thread was created.
  */
-void createThread(Thread* thread);
+bool createThread(Thread* thread);
 
 /**
  * Stop executing the current thread for the rest of this cycle. This can be
@@ -70,6 +92,26 @@ void createThread(Thread* thread);
  */
 void stopExecutingThreadForCycle();
 
+/**
+ * Stop executing the current thread until the given tick. The thread is not
+ * run again before wakeTick, so this is what sleeping is built on.
+ *
+ * @param wakeTick The first tick the thread may run again.
+ */
+void blockCurrentThread(int wakeTick);
+
+/**
+ * Changes the priority of a thread and lets the scheduler know so it can
+ * place the thread according to its new priority. A thread changing its own
+ * priority sees the new one when this returns; for any other thread this does
+ * not wait, like createThread, and the change is made before the next thread
+ * is picked. Must not be called from the scheduler callbacks.
+ *
+ * @param thread The thread to change.
+ * @param priority The new priority.
+ */
+void setThreadPriority(Thread* thread, int priority);
+
 /**
  * Returns a pointer to the thread that is currently running.
  *
@@ -87,6 +129,49 @@ Thread* getCurrentThread();
  */
 int getCurrentTick();
 
+/**
+ * Stops executing the current thread until the given thread has terminated.
+ * The caller is not run while it waits and is ready again on the tick after
+ * the thread ends.
+ *
+ * @param thread A thread created in the simulator.
+ * @return true once the thread has terminated, false if it is the current
+ * thread or was not created in the simulator.
+ */
+bool joinThread(Thread* thread);
+
+/**
+ * Stops executing the current thread until any of the given threads has
+ * terminated, like joinThread.
+ *
+ * @param threads The threads to wait for.
+ * @param count How many threads there are.
+ * @return The thread that terminated, or NULL if count is not positive or
+ * any of the threads is the current thread or was not created in the
+ * simulator.
+ */
+Thread* joinAny(Thread** threads, int count);
+
+/**
+ * Allocates a thread object with a copy of the given name. The other fields
+ * are set to DEFAULT_PRI, NULL and CREATED. Objects freed with freeThread are
+ * reused, so this is cheaper than allocating the thread and its name
+ * separately.
+ *
+ * @param name The name of the thread.
+ * @return The new thread, free it with freeThread.
+ */
+Thread* allocateThread(const char* name);
+
+/**
+ * Frees a thread object returned by allocateThread, including its name. A
+ * thread that has ended also gives its place in the simulator to the next
+ * thread created; a thread must not be freed while it runs or is joined.
+ *
+ * @param thread The thread to free, may be NULL.
+ */
+void freeThread(Thread* thread);
+
 // You are required to implement the functions in this header. The tests rely
 // on this to work correctly.
 
@@ -15,8 +15,8 @@ Thread* nextThreadToRun(int currentTick);
 
 /**
  * This function should prepare a thread to run which at a minimum means
- * building the thread object, calling createThread and adding to some sort of
- * ready list.  This is exactly what the default implementation does.
+ * building the thread object and calling createThread, which hands the thread
+ * to the scheduler (threadReady is called for it under the default policy).
  *
  * @param name The name of a thread.
  * @param func The function to run when starting the thread, this function
@@ -25,7 +25,7 @@ Thread* nextThreadToRun(int currentTick);
  * @param arg The argument to pass to the function that starts the thread.
  * @param pri The priority of a thread, minimum priority is 1, max is 10,
  * default is 5
- * @return The thread that was set to run.
+ * @return The thread that was set to run, or NULL if it could not be created.
  */
 Thread* createAndSetThreadToRun(const char* name,
                                 void* (*func)(void*),
@@ -60,6 +60,38 @@ void destroyThread(Thread* thread);
  */
 void setMyPriority(int newPriority);
 
+// The functions below are called by the framework when a thread changes
+// state, as long as the default scheduling policy is in use. You can use them
+// to keep your ready and sleep lists up to date.
+
+/**
+ * This function is called when a thread becomes ready to run, both when it is
+ * created and when it is woken after being blocked.
+ *
+ * @param thread The thread that is ready.
+ */
+void threadReady(Thread* thread);
+
+/**
+ * This function is called when the current thread stops being ready, it must
+ * not be returned by nextThreadToRun before wakeTick. The thread stops
+ * executing right after this function returns. It is also called with
+ * NO_WAKE_TICK for a thread that has ended, which is never ready again.
+ *
+ * @param thread The thread that is blocked.
+ * @param wakeTick The first tick the thread may run again, or NO_WAKE_TICK if
+ * it may not run until threadReady is called for it.
+ */
+void threadBlocked(Thread* thread, int wakeTick);
+
+/**
+ * This function is called after the priority of a thread has been changed.
+ *
+ * @param thread The thread whose priority changed.
+ * @param oldPriority The priority the thread had before.
+ */
+void threadPriorityChanged(Thread* thread, int oldPriority);
+
 /**
  * This function is called after the simulator is started but before the idle
  * thread starts running to allow you to initialize any objects you need to
@@ -0,0 +1,515 @@
+/**
+ * Stress driver for the simulator. Creates a large number of threads that run
+ * a seeded random mix of compute bursts, sleeps, nested locking, yields and
+ * priority changes, then reports throughput, scheduler cost and whether the
+ * run violated any scheduling invariants.
+ *
+ * Run with --help for the available options.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Lock.h"
+#include "Logger.h"
+#include "Replay.h"
+#include "Scheduler.h"
+#include "Stats.h"
+#include "Thread.h"
+
+typedef enum WorkerState {
+    WORKER_READY,
+    WORKER_SLEEPING,
+    WORKER_BLOCKED,
+    WORKER_DONE
+} WorkerState;
+
+typedef struct StressConfig {
+    int numThreads;
+    int numLocks;
+    int opsPerThread;
+    int maxSleep;
+    int maxBurst;
+    int maxNesting;
+    int stallSeconds;
+    unsigned int seed;
+    const char* policyName;
+    int sliceTicks;
+    const char* recordPath;
+    const char* replayPath;
+    int warnOverrunMicros;
+} StressConfig;
+
+/**
+ * Per thread bookkeeping. Only the owning thread writes these fields; other
+ * threads read them while the owner is paused, which is safe because the
+ * simulator runs a single thread per tick.
+ */
+typedef struct Worker {
+    int index;
+    unsigned int rng;
+    Thread* thread;
+    volatile WorkerState state;
+    volatile int wakeTick;
+} Worker;
+
+typedef struct StressReport {
+    long opsCompleted;
+    long sleeps;
+    long earlyWakeups;
+    long totalWakeLatency;
+    int maxWakeLatency;
+    long lockAcquisitions;
+    long yields;
+    long priorityChanges;
+    long priorityChecks;
+    long priorityViolations;
+    long threadsFinished;
+} StressReport;
+
+static StressConfig config;
+static Worker* workers;
+static const char** locks;
+static StressReport report;
+static pthread_mutex_t reportMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static long long monotonicNanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int randomBetween(Worker* worker, int low, int high) {
+    return low + rand_r(&worker->rng) % (high - low + 1);
+}
+
+static void countOp(long* counter, long amount) {
+    pthread_mutex_lock(&reportMutex);
+    if (counter != NULL)
+        *counter += amount;
+    report.opsCompleted++;
+    pthread_mutex_unlock(&reportMutex);
+}
+
+/**
+ * Called whenever a worker has just been dispatched again after giving up the
+ * CPU, with the priority it resumed at, which is the one the scheduler picked
+ * it with. No other thread that is ready (or whose sleep has expired) may have
+ * a higher priority, taking donation into account. A worker that kept the CPU
+ * is not checked, as it may have lowered itself since it was picked.
+ */
+static void checkPriority(Worker* self, int myPriority) {
+    int currentTick = getCurrentTick();
+    long violations = 0;
+    for (int x = 0; x < config.numThreads; x++) {
+        Worker* other = &workers[x];
+        if (other == self || other->thread == NULL)
+            continue;
+        bool ready = other->state == WORKER_READY ||
+                     (other->state == WORKER_SLEEPING &&
+                      other->wakeTick < currentTick);
+        if (ready && other->thread->priority > myPriority)
+            violations++;
+    }
+    pthread_mutex_lock(&reportMutex);
+    report.priorityChecks++;
+    if (violations > 0) {
+        report.priorityViolations++;
+        if (report.priorityViolations <= 5) {
+            char line[1024];
+            sprintf(line,
+                    "[stress] priority violation: %s (priority %d) ran on "
+                    "tick %d while %ld higher priority threads were ready",
+                    self->thread->name, myPriority, currentTick, violations);
+            logLine(line);
+        }
+    }
+    pthread_mutex_unlock(&reportMutex);
+}
+
+static void burst(Worker* worker) {
+    volatile unsigned long sum = 0;
+    int iterations = randomBetween(worker, 1, config.maxBurst);
+    for (int x = 0; x < iterations; x++) {
+        sum += x * x;
+    }
+}
+
+static void sleepOp(Worker* worker) {
+    int ticks = randomBetween(worker, 1, config.maxSleep);
+    worker->wakeTick = getCurrentTick() + ticks;
+    worker->state = WORKER_SLEEPING;
+    int started = tickSleep(ticks);
+    int picked = worker->thread->priority;
+    int woken = getCurrentTick();
+    worker->state = WORKER_READY;
+    checkPriority(worker, picked);
+
+    int latency = woken - (started + ticks);
+    pthread_mutex_lock(&reportMutex);
+    report.sleeps++;
+    if (latency < 0) {
+        report.earlyWakeups++;
+    } else {
+        report.totalWakeLatency += latency;
+        if (latency > report.maxWakeLatency)
+            report.maxWakeLatency = latency;
+    }
+    report.opsCompleted++;
+    pthread_mutex_unlock(&reportMutex);
+}
+
+static void yieldOp(Worker* worker) {
+    stopExecutingThreadForCycle();
+    checkPriority(worker, worker->thread->priority);
+}
+
+// Locks are always taken in index order so the workload cannot deadlock.
+static void nestedLockOp(Worker* worker) {
+    int depth = randomBetween(worker, 1, config.maxNesting);
+    if (depth > config.numLocks)
+        depth = config.numLocks;
+    int first = randomBetween(worker, 0, config.numLocks - depth);
+    for (int x = first; x < first + depth; x++) {
+        // Only a lock that was held makes the worker wait to be dispatched
+        // again.
+        if (!tryLock(locks[x])) {
+            worker->state = WORKER_BLOCKED;
+            lock(locks[x]);
+            int picked = worker->thread->priority;
+            worker->state = WORKER_READY;
+            checkPriority(worker, picked);
+        }
+        burst(worker);
+    }
+    if (randomBetween(worker, 0, 1) == 1) {
+        yieldOp(worker);
+    }
+    for (int x = first + depth - 1; x >= first; x--) {
+        unlock(locks[x]);
+    }
+    countOp(&report.lockAcquisitions, depth);
+}
+
+static void* stressWorker(void* arg) {
+    Worker* worker = (Worker*)arg;
+    checkPriority(worker, worker->thread->priority);
+    for (int op = 0; op < config.opsPerThread; op++) {
+        switch (randomBetween(worker, 0, 4)) {
+            case 0:
+                burst(worker);
+                countOp(NULL, 0);
+                break;
+            case 1:
+                sleepOp(worker);
+                break;
+            case 2:
+                nestedLockOp(worker);
+                break;
+            case 3:
+                setMyPriority(randomBetween(worker, MIN_PRI, MAX_PRI));
+                countOp(&report.priorityChanges, 1);
+                break;
+            case 4:
+                yieldOp(worker);
+                countOp(&report.yields, 1);
+                break;
+        }
+    }
+    worker->state = WORKER_DONE;
+    pthread_mutex_lock(&reportMutex);
+    report.threadsFinished++;
+    pthread_mutex_unlock(&reportMutex);
+    return NULL;
+}
+
+// Creating the workers from a simulated thread keeps creation serialized with
+// the scheduler instead of racing it from the main thread.
+static void* spawnWorkers(void*) {
+    for (int x = 0; x < config.numLocks; x++) {
+        locks[x] = createLock();
+    }
+    for (int x = 0; x < config.numThreads; x++) {
+        Worker* worker = &workers[x];
+        char name[32];
+        sprintf(name, "Stress %d", x);
+        int pri = randomBetween(worker, MIN_PRI, MAX_PRI);
+        worker->thread =
+            createAndSetThreadToRun(name, stressWorker, (void*)worker, pri);
+    }
+    return NULL;
+}
+
+// Missed wakeups show up as a run that never finishes, so a watchdog reports
+// what every unfinished thread was doing once progress stops.
+static void* watchdog(void*) {
+    long lastOps = -1;
+    int stalledFor = 0;
+    while (true) {
+        sleep(1);
+        pthread_mutex_lock(&reportMutex);
+        long ops = report.opsCompleted;
+        long finished = report.threadsFinished;
+        pthread_mutex_unlock(&reportMutex);
+        if (finished == config.numThreads)
+            return NULL;
+        stalledFor = ops == lastOps ? stalledFor + 1 : 0;
+        lastOps = ops;
+        if (stalledFor >= config.stallSeconds) {
+            int currentTick = getCurrentTick();
+            fprintf(stderr, "[stress] no progress for %d s at tick %d\n",
+                    stalledFor, currentTick);
+            for (int x = 0; x < config.numThreads; x++) {
+                Worker* worker = &workers[x];
+                if (worker->thread == NULL || worker->state == WORKER_DONE)
+                    continue;
+                fprintf(stderr, "[stress]   %s state %d wake tick %d%s\n",
+                        worker->thread->name, worker->state, worker->wakeTick,
+                        worker->state == WORKER_SLEEPING &&
+                                worker->wakeTick < currentTick
+                            ? " (missed wakeup)"
+                            : "");
+            }
+            fprintf(stderr, "[stress] invariants: FAIL (stalled)\n");
+            _exit(2);
+        }
+    }
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --threads N     simulated threads to create (default %d)\n"
+            "  --locks N       shared locks (default %d)\n"
+            "  --ops N         operations per thread (default %d)\n"
+            "  --max-sleep N   longest tickSleep in ticks (default %d)\n"
+            "  --max-burst N   longest compute burst in loop iterations "
+            "(default %d)\n"
+            "  --max-nesting N most locks held at once (default %d)\n"
+            "  --stall N       seconds without progress before failing "
+            "(default %d)\n"
+            "  --seed N        random seed (default %u)\n"
+            "  --policy NAME   scheduling policy (default priority-rr)\n"
+            "  --slice N       priority-rr time slice in ticks below "
+            "DEFAULT_PRI (default %d)\n"
+            "  --record FILE   record the schedule into FILE\n"
+            "  --replay FILE   replay a schedule recorded with the same "
+            "options\n"
+            "  --warn-overrun N log ticks that run over by more than N us\n",
+            program, config.numThreads, config.numLocks, config.opsPerThread,
+            config.maxSleep, config.maxBurst, config.maxNesting,
+            config.stallSeconds, config.seed, config.sliceTicks);
+}
+
+static bool parseArguments(int argc, char** argv) {
+    static struct option options[] = {
+        {"threads", required_argument, NULL, 't'},
+        {"locks", required_argument, NULL, 'l'},
+        {"ops", required_argument, NULL, 'o'},
+        {"max-sleep", required_argument, NULL, 's'},
+        {"max-burst", required_argument, NULL, 'b'},
+        {"max-nesting", required_argument, NULL, 'n'},
+        {"stall", required_argument, NULL, 'w'},
+        {"seed", required_argument, NULL, 'r'},
+        {"policy", required_argument, NULL, 'p'},
+        {"slice", required_argument, NULL, 'S'},
+        {"record", required_argument, NULL, 'R'},
+        {"replay", required_argument, NULL, 'P'},
+        {"warn-overrun", required_argument, NULL, 'W'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    int option;
+    while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (option) {
+            case 't':
+                config.numThreads = atoi(optarg);
+                break;
+            case 'l':
+                config.numLocks = atoi(optarg);
+                break;
+            case 'o':
+                config.opsPerThread = atoi(optarg);
+                break;
+            case 's':
+                config.maxSleep = atoi(optarg);
+                break;
+            case 'b':
+                config.maxBurst = atoi(optarg);
+                break;
+            case 'n':
+                config.maxNesting = atoi(optarg);
+                break;
+            case 'w':
+                config.stallSeconds = atoi(optarg);
+                break;
+            case 'r':
+                config.seed = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                config.policyName = optarg;
+                break;
+            case 'S':
+                config.sliceTicks = atoi(optarg);
+                break;
+            case 'R':
+                config.recordPath = optarg;
+                break;
+            case 'P':
+                config.replayPath = optarg;
+                break;
+            case 'W':
+                config.warnOverrunMicros = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return false;
+        }
+    }
+    if (config.numThreads < 1 || config.numLocks < 1 || config.maxSleep < 1 ||
+        config.maxBurst < 1 || config.maxNesting < 1 ||
+        config.sliceTicks < 1 || config.warnOverrunMicros < 0) {
+        usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    config.numThreads = 2000;
+    config.numLocks = 32;
+    config.opsPerThread = 4;
+    config.maxSleep = 20;
+    config.maxBurst = 100000;
+    config.maxNesting = 3;
+    config.stallSeconds = 30;
+    config.seed = 1;
+    config.sliceTicks = 1;
+    if (!parseArguments(argc, argv))
+        return 1;
+
+    workers = (Worker*)calloc(config.numThreads, sizeof(Worker));
+    locks = (const char**)calloc(config.numLocks, sizeof(const char*));
+    for (int x = 0; x < config.numThreads; x++) {
+        workers[x].index = x;
+        workers[x].rng = config.seed * 2654435761u + x;
+        workers[x].state = WORKER_READY;
+    }
+
+    if (config.recordPath != NULL)
+        recordSchedule(config.recordPath);
+    if (config.replayPath != NULL)
+        replaySchedule(config.replayPath);
+    // Batch work below DEFAULT_PRI gets the long slices, everything above
+    // keeps switching every tick.
+    TimeSliceConfig sliceConfig;
+    for (int priority = MIN_PRI; priority <= MAX_PRI; priority++) {
+        sliceConfig.sliceTicks[priority - MIN_PRI] =
+            priority < DEFAULT_PRI ? config.sliceTicks : 1;
+    }
+    setTimeSliceConfig(&sliceConfig);
+    setTickOverrunWarning(config.warnOverrunMicros);
+    long long started = monotonicNanos();
+    startSystem(config.policyName);
+    Thread* spawner =
+        createAndSetThreadToRun("Stress spawner", spawnWorkers, NULL, MAX_PRI);
+    pthread_t watchdogThread;
+    pthread_create(&watchdogThread, NULL, watchdog, NULL);
+    stopSystem();
+    double seconds = (monotonicNanos() - started) / 1e9;
+    pthread_join(watchdogThread, NULL);
+
+    SchedulerStats stats;
+    getSchedulerStats(&stats);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    int ticks = stats.ticks > 0 ? stats.ticks : 1;
+
+    printf("[stress] threads %d, locks %d, ops/thread %d, seed %u, policy %s\n",
+           config.numThreads, config.numLocks, config.opsPerThread,
+           config.seed,
+           config.policyName != NULL ? config.policyName : "priority-rr");
+    printf("[stress] %d ticks (%d idle) in %.2f s: %.1f ticks/s\n",
+           stats.ticks, stats.idleTicks, seconds, stats.ticks / seconds);
+    printf("[stress] scheduler %.2f us/tick, context switch %.2f us/tick, "
+           "%ld dispatches, %ld continuations, %ld preemptions\n",
+           stats.schedulerNanos / 1e3 / ticks,
+           stats.switchNanos / 1e3 / ticks, stats.dispatches,
+           stats.continuations, stats.preemptions);
+    TickTimingStats timing;
+    getTickTimingStats(&timing);
+    printf("[stress] tick drift %+.2f ms, %ld overruns totalling %.2f ms "
+           "(max %.2f ms), %ld warnings\n",
+           timing.driftNanos / 1e6, timing.overruns, timing.overrunNanos / 1e6,
+           timing.maxOverrunNanos / 1e6, timing.overrunWarnings);
+    printf("[stress] peak RSS %ld KB\n", usage.ru_maxrss);
+    if (config.replayPath != NULL)
+        printf("[stress] replay diverged on %ld ticks\n",
+               stats.replayDivergences);
+    if (config.policyName != NULL && strcmp(config.policyName, "cfs") == 0) {
+        FairShareStats fairStats;
+        getFairShareStats(&fairStats);
+        double meanLatency =
+            fairStats.picks ? (double)fairStats.totalLatency / fairStats.picks
+                            : 0;
+        printf("[stress] cfs: mean latency %.2f ticks, max %d, fairness %.3f, "
+               "vruntime spread %.1f ticks, %ld wakeup preemptions\n",
+               meanLatency, fairStats.maxLatency, fairStats.fairness,
+               fairStats.vruntimeSpread, fairStats.wakeupPreemptions);
+    }
+    if (config.policyName != NULL && strcmp(config.policyName, "mlfq") == 0) {
+        MlfqStats mlfqStats;
+        getMlfqStats(&mlfqStats);
+        printf("[stress] mlfq: %ld demotions, %ld promotions, %ld aging "
+               "passes, picks per level",
+               mlfqStats.demotions, mlfqStats.promotions,
+               mlfqStats.agingPasses);
+        for (int x = 0; x < MLFQ_MAX_LEVELS; x++) {
+            printf(" %ld", mlfqStats.levelPicks[x]);
+        }
+        printf("\n");
+    }
+    printf("[stress] %ld sleeps, mean wake latency %.2f ticks, max %d\n",
+           report.sleeps,
+           report.sleeps ? (double)report.totalWakeLatency / report.sleeps : 0,
+           report.maxWakeLatency);
+    printf("[stress] %ld lock acquisitions, %ld yields, %ld priority changes\n",
+           report.lockAcquisitions, report.yields, report.priorityChanges);
+
+    bool pass = true;
+    if (report.threadsFinished != config.numThreads) {
+        printf("[stress] FAIL: %ld of %d threads finished\n",
+               report.threadsFinished, config.numThreads);
+        pass = false;
+    }
+    if (report.earlyWakeups > 0) {
+        printf("[stress] FAIL: %ld threads woke before their wake tick\n",
+               report.earlyWakeups);
+        pass = false;
+    }
+    // Only the default policy promises strict priority order; for the others
+    // the count shows how far they trade priority for fairness.
+    bool strictPriority = config.policyName == NULL ||
+                          strcmp(config.policyName, "priority-rr") == 0;
+    if (report.priorityViolations > 0) {
+        printf("[stress] %s: %ld of %ld dispatches ran below a ready "
+               "higher priority thread\n",
+               strictPriority ? "FAIL" : "note", report.priorityViolations,
+               report.priorityChecks);
+        pass = pass && !strictPriority;
+    }
+    printf("[stress] invariants: %s\n", pass ? "PASS" : "FAIL");
+
+    for (int x = 0; x < config.numThreads; x++) {
+        if (workers[x].thread)
+            destroyThread(workers[x].thread);
+    }
+    destroyThread(spawner);
+    free(workers);
+    free(locks);
+    return pass ? 0 : 1;
+}
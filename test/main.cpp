@@ -1,11 +1,23 @@
 #include <malloc.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <cstring>
+#include <string>
 #include "Lock.h"
 #include "Logger.h"
 #include "Map.h"
+#include "Replay.h"
+#include "Scheduler.h"
+#include "Simulator.h"
+#include "Stats.h"
+#include "StatsPage.h"
+#include "Sync.h"
 #include "Thread.h"
 #include "gtest/gtest.h"
+#include "threading/EventQueue.h"
+#include "threading/ScanKernels.h"
+#include "threading/ThreadingConstants.h"
 #include "test_config.h"
 #include "test_helper.h"
 
@@ -104,10 +116,126 @@ TEST(Running, SetMyPriority) {
                                              (void*)arg, DEFAULT_PRI);
     stopSystem();
     EXPECT_EQ(MAX_PRI, thread->priority);
+    EXPECT_EQ(MAX_PRI, *arg);
     destroyThread(thread);
     free(arg);
 }
 
+TEST(Running, ThreadRecordsAreReused) {
+    const char* longName = "A thread name too long to be kept in its record";
+    Thread* first = allocateThread("Short");
+    Thread* second = allocateThread(longName);
+    Thread* third = allocateThread(longName);
+    EXPECT_STREQ("Short", first->name);
+    EXPECT_EQ(CREATED, first->state);
+    EXPECT_STREQ(longName, second->name);
+    // Long names are interned, so threads that share one share its copy.
+    EXPECT_EQ(second->name, third->name);
+    EXPECT_NE(longName, second->name);
+
+    freeThread(first);
+    Thread* reused = allocateThread("Reused");
+    EXPECT_EQ(first, reused);
+    EXPECT_STREQ("Reused", reused->name);
+
+    freeThread(reused);
+    freeThread(second);
+    freeThread(third);
+}
+
+TEST(Running, SlotsAreReused) {
+    startSystem();
+    SpinInfo spinInfo[2];
+    spinInfo[0].ticksToSpin = 1;
+    spinInfo[1].ticksToSpin = 1;
+    Thread* first = createAndSetThreadToRun("First", spinTest,
+                                            (void*)&spinInfo[0], DEFAULT_PRI);
+    ASSERT_TRUE(first != NULL);
+    EXPECT_TRUE(joinThread(first));
+    int firstSlot = first->slot;
+    destroyThread(first);
+    Thread* second = createAndSetThreadToRun("Second", spinTest,
+                                             (void*)&spinInfo[1], DEFAULT_PRI);
+    ASSERT_TRUE(second != NULL);
+    // The index of the freed thread is taken again, under a new generation.
+    int indexMask = (1 << Threading::SLOT_INDEX_BITS) - 1;
+    EXPECT_EQ(firstSlot & indexMask, second->slot & indexMask);
+    EXPECT_NE(firstSlot, second->slot);
+    EXPECT_TRUE(joinThread(second));
+    stopSystem();
+    destroyThread(second);
+}
+
+TEST(Running, EndedThreadsLeaveReadyList) {
+    startSystem();
+    ReadyListInfo info;
+    Thread* parent = createAndSetThreadToRun(
+        "Parent", joinLowerPriorityChild, (void*)&info, MAX_PRI);
+    stopSystem();
+    EXPECT_EQ(1, info.readyAfterJoin);
+    destroyThread(parent);
+}
+
+TEST(Running, JoinWaitsForTermination) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    SpinInfo* spinInfo = (SpinInfo*)calloc(2, sizeof(SpinInfo));
+    spinInfo[0].ticksToSpin = 5;
+    spinInfo[1].ticksToSpin = 15;
+    Thread* spinners[2];
+    for (int x = 0; x < 2; x++) {
+        spinners[x] = createAndSetThreadToRun("Spin", spinTest,
+                                              (void*)&spinInfo[x], DEFAULT_PRI);
+    }
+    JoinInfo joinInfo;
+    bzero(&joinInfo, sizeof(JoinInfo));
+    joinInfo.threads = spinners;
+    joinInfo.count = 2;
+    Thread* joiner = createAndSetThreadToRun("Join", joinTest,
+                                             (void*)&joinInfo, MAX_PRI);
+    // The main thread is outside the simulation and can join as well.
+    EXPECT_TRUE(joinThread(joiner));
+    EXPECT_FALSE(joinThread(NULL));
+    stopSystem();
+
+    // The joiner runs again on the first tick after each spinner ends.
+    EXPECT_EQ(spinners[0], joinInfo.firstEnded);
+    EXPECT_EQ(spinInfo[0].tickFinished + 1, joinInfo.firstJoinedTick);
+    EXPECT_EQ(spinInfo[1].tickFinished + 1, joinInfo.lastJoinedTick);
+
+    destroyThread(joiner);
+    destroyThread(spinners[0]);
+    destroyThread(spinners[1]);
+    free(spinInfo);
+}
+
+TEST(Running, OnlyCreatedThreadsAreJoinable) {
+    SpinInfo spinInfo[2];
+    bzero(spinInfo, sizeof(spinInfo));
+    spinInfo[0].ticksToSpin = 2;
+    spinInfo[1].ticksToSpin = 2;
+    startSystem();
+    Thread* ran = createAndSetThreadToRun("Spin", spinTest,
+                                          (void*)&spinInfo[0], DEFAULT_PRI);
+    stopSystem();
+
+    startSystem();
+    Thread* other = createAndSetThreadToRun("Spin", spinTest,
+                                            (void*)&spinInfo[1], DEFAULT_PRI);
+    destroyThread(ran);
+    Thread* reused = allocateThread("Reused");
+    EXPECT_EQ(ran, reused);
+    // The record was created in the last run, but this thread never was.
+    EXPECT_FALSE(joinThread(reused));
+    EXPECT_TRUE(joinThread(other));
+    stopSystem();
+
+    freeThread(reused);
+    destroyThread(other);
+}
+
 TEST(Sleep, SingleThread) {
     startSystem();
 #ifdef TEST_VERBOSE
@@ -150,6 +278,110 @@ TEST(Sleep, MultipleThreads) {
     free(sleepInfo);
 }
 
+TEST(Sleep, SleepersAreCounted) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    SleepInfo* sleepInfo = (SleepInfo*)malloc(sizeof(SleepInfo) * 2);
+    sleepInfo[0].ticksToSleep = 10;
+    sleepInfo[1].ticksToSleep = 20;
+    Thread* thread = createAndSetThreadToRun("Sleep", sleepTest,
+                                             (void*)&sleepInfo[0], DEFAULT_PRI);
+    Thread* thread2 = createAndSetThreadToRun(
+        "Sleep", sleepTest, (void*)&sleepInfo[1], DEFAULT_PRI);
+    SchedulerStats stats;
+    while (getCurrentTick() < 6) {
+        usleep(1000);
+    }
+    getSchedulerStats(&stats);
+    EXPECT_EQ(0, stats.readyThreads);
+    EXPECT_EQ(2, stats.sleepingThreads);
+    // The first sleeper wakes around tick 11 and ends; the second sleeps on.
+    while (getCurrentTick() < 16) {
+        usleep(1000);
+    }
+    getSchedulerStats(&stats);
+    EXPECT_EQ(0, stats.readyThreads);
+    EXPECT_EQ(1, stats.sleepingThreads);
+    EXPECT_EQ(0, stats.blockedThreads);
+    stopSystem();
+
+    destroyThread(thread);
+    destroyThread(thread2);
+    free(sleepInfo);
+}
+
+TEST(Sleep, StatsPageShowsSleepers) {
+    const char* pageName = "project2_test_stats";
+    publishStats(pageName);
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    SleepInfo sleepInfo;
+    sleepInfo.ticksToSleep = 10;
+    Thread* thread = createAndSetThreadToRun("Sleep", sleepTest,
+                                             (void*)&sleepInfo, DEFAULT_PRI);
+    while (getCurrentTick() < 6) {
+        usleep(1000);
+    }
+    const StatsPage* page = mapStatsPage(pageName);
+    ASSERT_TRUE(page != NULL);
+    StatsPageCounters counters;
+    readStatsPage(page, &counters);
+    EXPECT_EQ(1, counters.running);
+    EXPECT_GE(counters.tick, 5);
+    EXPECT_EQ(1, counters.sleepingThreads);
+    EXPECT_GT(counters.ticksPerSecond, 0);
+    stopSystem();
+
+    // The page keeps the counters of the run once it has ended.
+    SchedulerStats stats;
+    getSchedulerStats(&stats);
+    readStatsPage(page, &counters);
+    EXPECT_EQ(0, counters.running);
+    EXPECT_EQ(stats.ticks, counters.tick);
+    EXPECT_EQ(stats.dispatches, counters.contextSwitches);
+    unmapStatsPage(page);
+    unlink("/dev/shm/project2_test_stats");
+    destroyThread(thread);
+}
+
+TEST(Sleep, IdleTicksAreTimed) {
+    // Nothing runs while the thread sleeps, and an idle tick sleeps for at
+    // least a whole tick, so each of them overruns.
+    setTickOverrunWarning(1);
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    SleepInfo sleepInfo;
+    sleepInfo.ticksToSleep = 4;
+    Thread* thread = createAndSetThreadToRun("Sleep", sleepTest,
+                                             (void*)&sleepInfo, DEFAULT_PRI);
+    stopSystem();
+    setTickOverrunWarning(0);
+
+    SchedulerStats stats;
+    getSchedulerStats(&stats);
+    TickTimingStats timing;
+    getTickTimingStats(&timing);
+    EXPECT_EQ(stats.ticks, timing.ticks);
+    EXPECT_GT(timing.nominalNanos, 0);
+    long timed = 0;
+    long switches = 0;
+    for (int x = 0; x < TIMING_BUCKETS; x++) {
+        timed += timing.tickHistogram[x];
+        switches += timing.switchHistogram[x];
+    }
+    EXPECT_EQ(timing.ticks, timed);
+    EXPECT_GE(switches, stats.dispatches);
+    EXPECT_GE(timing.overrunWarnings, stats.idleTicks);
+    EXPECT_GT(timing.maxOverrunNanos, 0);
+    destroyThread(thread);
+}
+
 TEST(Locking, SingleLock) {
     startSystem();
 #ifdef TEST_VERBOSE
@@ -170,6 +402,91 @@ TEST(Locking, SingleLock) {
     free(threadHoldingLock);
 }
 
+TEST(Locking, UncontendedFastPath) {
+    startSystem();
+    const char* fastLock = createLock();
+    for (int x = 0; x < 100; x++) {
+        ASSERT_TRUE(lock(fastLock));
+        EXPECT_TRUE(isLocked(fastLock));
+        // Held from outside the simulation.
+        EXPECT_EQ(NULL, getLockHolder(fastLock));
+        ASSERT_TRUE(unlock(fastLock));
+    }
+    EXPECT_FALSE(isLocked(fastLock));
+    EXPECT_FALSE(unlock(fastLock));
+
+    LockStats stats;
+    ASSERT_TRUE(getLockStats(fastLock, &stats));
+    EXPECT_EQ(100, stats.acquisitions);
+    EXPECT_EQ(0, stats.contentions);
+    destroyLock(fastLock);
+    EXPECT_FALSE(lock(fastLock));
+    stopSystem();
+}
+
+TEST(Locking, UnknownIdsFail) {
+    startSystem();
+    const char* realLock = createLock();
+    // Only the id createLock returned names the lock, as before the fast
+    // path; a copy of it or a made-up id is simply not a lock.
+    char* copiedId = strdup(realLock);
+    std::string copiedString(realLock);
+    const char* bogusId = "not-a-lock";
+    EXPECT_FALSE(lock(copiedId));
+    EXPECT_FALSE(unlock(copiedId));
+    EXPECT_FALSE(lock(copiedString.c_str()));
+    EXPECT_FALSE(tryLock(bogusId));
+    EXPECT_FALSE(lock(bogusId));
+    EXPECT_FALSE(unlock(bogusId));
+    EXPECT_FALSE(isLocked(realLock));
+    ASSERT_TRUE(lock(realLock));
+    EXPECT_FALSE(unlock(copiedId));
+    EXPECT_TRUE(unlock(realLock));
+    destroyLock(realLock);
+    free(copiedId);
+    stopSystem();
+}
+
+TEST(Locking, TimedLockGivesUp) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    TimedLockInfo info;
+    bzero(&info, sizeof(TimedLockInfo));
+    info.lock = createLock();
+    info.holdTicks = 10;
+    info.timeoutTicks = 3;
+    ThreadCallbackInfo waiterCallback;
+    waiterCallback.threadName = NAME_HI_PRI;
+    waiterCallback.func = timedLockWaiter;
+    waiterCallback.arg = &info;
+    waiterCallback.pri = MAX_PRI;
+    info.tcbi = &waiterCallback;
+
+    Thread* holder = createAndSetThreadToRun(NAME_LO_PRI, timedLockHolder,
+                                             (void*)&info, DEFAULT_PRI);
+    stopSystem();
+
+    // The waiter gives up on the tick its timeout runs out. Later it gets the
+    // lock on the tick after the holder lets go of it, which is the holder's
+    // last tick.
+    EXPECT_FALSE(info.tryLocked);
+    EXPECT_FALSE(info.timedLocked);
+    EXPECT_EQ(info.waitStarted + info.timeoutTicks, info.waitEnded);
+    EXPECT_EQ(info.releasedTick + 1, info.acquiredTick);
+    EXPECT_EQ(DEFAULT_PRI, holder->priority);
+
+    LockStats stats;
+    ASSERT_TRUE(getLockStats(info.lock, &stats));
+    EXPECT_EQ(2, stats.acquisitions);
+    EXPECT_EQ(1, stats.contentions);
+
+    destroyThread(info.created);
+    destroyThread(holder);
+    destroyLock(info.lock);
+}
+
 TEST(Locking, PriorityDonation) {
 #ifdef I_HAVE_NOT_IMPLEMENTED_PRIORITY_DONATION
     FAIL() << "To enable this test look at answer/test_config.h\n";
@@ -234,3 +551,703 @@ TEST(Locking, PriorityDonation) {
     free(threadOrder);
     free(donationInfo);
 }
+
+TEST(Locking, NestedDonation) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    const char* outerLock = createLock();
+    const char* innerLock = createLock();
+    int* numThreadsFinished = (int*)calloc(1, sizeof(int));
+    NestedLockInfo* info = (NestedLockInfo*)calloc(3, sizeof(NestedLockInfo));
+    for (int x = 0; x < 3; x++) {
+        info[x].numThreadsFinished = numThreadsFinished;
+    }
+
+    ThreadCallbackInfo midCallback;
+    midCallback.threadName = NAME_MD_PRI;
+    midCallback.func = nestedDonation;
+    midCallback.arg = &info[1];
+    midCallback.pri = DEFAULT_PRI;
+
+    ThreadCallbackInfo hiCallback;
+    hiCallback.threadName = NAME_HI_PRI;
+    hiCallback.func = nestedDonation;
+    hiCallback.arg = &info[2];
+    hiCallback.pri = MAX_PRI;
+
+    // Low holds the outer lock, mid holds the inner one and waits for the
+    // outer, and high then waits for the inner lock.
+    info[0].firstLock = outerLock;
+    info[0].tcbi = &midCallback;
+    info[1].firstLock = innerLock;
+    info[1].secondLock = outerLock;
+    info[1].tcbi = &hiCallback;
+    info[2].firstLock = innerLock;
+
+    Thread* lowPriThread = createAndSetThreadToRun(NAME_LO_PRI, nestedDonation,
+                                                   (void*)&info[0], MIN_PRI);
+    stopSystem();
+
+    // High's priority reaches low through mid, and mid keeps it while high
+    // still waits for the inner lock.
+    EXPECT_EQ(MAX_PRI, info[0].priorityHeld);
+    EXPECT_EQ(MAX_PRI, info[1].priorityHeld);
+    for (int x = 0; x < 3; x++) {
+        EXPECT_EQ(x, info[x].finishedAs);
+    }
+    EXPECT_EQ(MIN_PRI, lowPriThread->priority);
+    EXPECT_EQ(DEFAULT_PRI, info[0].created->priority);
+    // Every thread runs once up to the point where it waits and once more
+    // when it gets its lock; a waiting thread is never dispatched.
+    SchedulerStats stats;
+    getSchedulerStats(&stats);
+    EXPECT_EQ(6, stats.dispatches);
+
+    destroyThread(info[1].created);
+    destroyThread(info[0].created);
+    destroyThread(lowPriThread);
+    destroyLock(outerLock);
+    destroyLock(innerLock);
+    free(numThreadsFinished);
+    free(info);
+}
+
+TEST(Locking, ReadWriteDonation) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    const char* rwLock = createReadWriteLock(true);
+    int* numThreadsFinished = (int*)calloc(1, sizeof(int));
+    ReadWriteInfo* info = (ReadWriteInfo*)calloc(4, sizeof(ReadWriteInfo));
+    ThreadCallbackInfo* callbacks =
+        (ThreadCallbackInfo*)calloc(3, sizeof(ThreadCallbackInfo));
+    const char* names[] = {NAME_LO_PRI, NAME_MD_PRI, NAME_HI_PRI};
+    int priorities[] = {MIN_PRI + 1, DEFAULT_PRI, MAX_PRI};
+    for (int x = 0; x < 4; x++) {
+        info[x].lock = rwLock;
+        info[x].numThreadsFinished = numThreadsFinished;
+        if (x < 3) {
+            info[x].tcbi = &callbacks[x];
+            callbacks[x].threadName = names[x];
+            callbacks[x].func = readWriteLocker;
+            callbacks[x].arg = &info[x + 1];
+            callbacks[x].pri = priorities[x];
+        }
+    }
+
+    // Two low readers share the lock, each created ahead of the one before so
+    // it runs at once. A medium writer waits for them and a high reader then
+    // arrives, which has to wait behind the writer.
+    info[2].exclusive = true;
+    info[2].createFirst = true;
+
+    Thread* firstReader = createAndSetThreadToRun(NAME_LO_PRI, readWriteLocker,
+                                                  (void*)&info[0], MIN_PRI);
+    stopSystem();
+
+    // Both readers get the high priority through the writer, and the writer
+    // gets it from the reader waiting behind it.
+    EXPECT_EQ(MAX_PRI, info[0].priorityHeld);
+    EXPECT_EQ(MAX_PRI, info[1].priorityHeld);
+    EXPECT_EQ(MAX_PRI, info[2].priorityHeld);
+    EXPECT_LT(info[0].finishedAs, 2);
+    EXPECT_LT(info[1].finishedAs, 2);
+    EXPECT_EQ(2, info[2].finishedAs);
+    EXPECT_EQ(3, info[3].finishedAs);
+    EXPECT_EQ(MIN_PRI, firstReader->priority);
+    EXPECT_EQ(MIN_PRI + 1, info[0].created->priority);
+    EXPECT_EQ(DEFAULT_PRI, info[1].created->priority);
+
+    LockStats stats;
+    ASSERT_TRUE(getLockStats(rwLock, &stats));
+    EXPECT_EQ(4, stats.acquisitions);
+    EXPECT_EQ(3, stats.sharedAcquisitions);
+    EXPECT_EQ(2, stats.contentions);
+    EXPECT_EQ(5, stats.donations);
+
+    destroyThread(info[2].created);
+    destroyThread(info[1].created);
+    destroyThread(info[0].created);
+    destroyThread(firstReader);
+    destroyLock(rwLock);
+    free(numThreadsFinished);
+    free(callbacks);
+    free(info);
+}
+
+TEST(Sync, SemaphoreWakesByPriority) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    const char* semaphore = createSemaphore(0);
+    int* numThreadsFinished = (int*)calloc(1, sizeof(int));
+    SemaphoreInfo* info = (SemaphoreInfo*)calloc(3, sizeof(SemaphoreInfo));
+    for (int x = 0; x < 3; x++) {
+        info[x].semaphore = semaphore;
+        info[x].numThreadsFinished = numThreadsFinished;
+    }
+    info[2].posts = 2;
+
+    ThreadCallbackInfo hiCallback;
+    hiCallback.threadName = NAME_HI_PRI;
+    hiCallback.func = semaphoreWaiter;
+    hiCallback.arg = &info[1];
+    hiCallback.pri = DEFAULT_PRI + 1;
+    info[0].tcbi = &hiCallback;
+
+    // Low starts waiting before high does, but high is woken first.
+    Thread* lowPriThread = createAndSetThreadToRun(
+        NAME_LO_PRI, semaphoreWaiter, (void*)&info[0], DEFAULT_PRI - 1);
+    Thread* poster = createAndSetThreadToRun("Poster", semaphorePoster,
+                                             (void*)&info[2], MIN_PRI);
+    stopSystem();
+
+    EXPECT_EQ(0, info[1].finishedAs);
+    EXPECT_EQ(1, info[0].finishedAs);
+    EXPECT_EQ(2, *numThreadsFinished);
+
+    destroyThread(info[0].created);
+    destroyThread(lowPriThread);
+    destroyThread(poster);
+    destroySemaphore(semaphore);
+    free(numThreadsFinished);
+    free(info);
+}
+
+TEST(Sync, ConditionWaitsWithoutPolling) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    ConditionInfo* info = (ConditionInfo*)calloc(1, sizeof(ConditionInfo));
+    info->lock = createLock();
+    info->condition = createCondition();
+    info->itemsWanted = 3;
+    Thread* consumer = createAndSetThreadToRun(NAME_HI_PRI, conditionConsumer,
+                                               (void*)info, DEFAULT_PRI + 1);
+    Thread* producer = createAndSetThreadToRun(NAME_LO_PRI, conditionProducer,
+                                               (void*)info, DEFAULT_PRI - 1);
+    stopSystem();
+
+    // The consumer only comes back once per item even though it has the
+    // higher priority.
+    EXPECT_EQ(info->itemsWanted, info->items);
+    EXPECT_EQ(info->itemsWanted, info->wakeups);
+
+    destroyThread(consumer);
+    destroyThread(producer);
+    destroyCondition(info->condition);
+    destroyLock(info->lock);
+    free(info);
+}
+
+TEST(Sync, ConditionWaitNeedsTheLock) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    ConditionInfo* info = (ConditionInfo*)calloc(1, sizeof(ConditionInfo));
+    info->lock = createLock();
+    info->condition = createCondition();
+    Thread* waiter = createAndSetThreadToRun("Waiter", conditionWaitUnlocked,
+                                             (void*)info, DEFAULT_PRI);
+    stopSystem();
+
+    // Waiting without holding the lock fails instead of releasing a lock the
+    // caller never took.
+    EXPECT_EQ(0, info->wakeups);
+    EXPECT_EQ(NULL, getLockHolder(info->lock));
+
+    destroyThread(waiter);
+    destroyCondition(info->condition);
+    destroyLock(info->lock);
+    free(info);
+}
+
+TEST(Policies, FairShareRunsLowPriority) {
+    startSystem("cfs");
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    SpinInfo* spinInfo = (SpinInfo*)calloc(2, sizeof(SpinInfo));
+    spinInfo[0].ticksToSpin = 20;
+    spinInfo[1].ticksToSpin = 1;
+    Thread* hiThread = createAndSetThreadToRun(NAME_HI_PRI, spinTest,
+                                               (void*)&spinInfo[0], MAX_PRI);
+    Thread* loThread = createAndSetThreadToRun(NAME_LO_PRI, spinTest,
+                                               (void*)&spinInfo[1], MIN_PRI);
+    stopSystem();
+
+    // Strict priority would hold the low priority thread back until the high
+    // priority one is done.
+    EXPECT_LT(spinInfo[1].tickStarted, spinInfo[0].tickFinished);
+    FairShareStats stats;
+    getFairShareStats(&stats);
+    EXPECT_GT(stats.picks, 0);
+
+    destroyThread(hiThread);
+    destroyThread(loThread);
+    free(spinInfo);
+}
+
+TEST(Policies, MlfqFavorsSleepers) {
+    startSystem("mlfq");
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    SpinInfo* spinInfo = (SpinInfo*)calloc(1, sizeof(SpinInfo));
+    spinInfo->ticksToSpin = 20;
+    SleepInfo* sleepInfo = (SleepInfo*)calloc(1, sizeof(SleepInfo));
+    sleepInfo->ticksToSleep = 10;
+    Thread* spinThread = createAndSetThreadToRun("Spin", spinTest,
+                                                 (void*)spinInfo, DEFAULT_PRI);
+    Thread* sleepThread = createAndSetThreadToRun(
+        "Sleep", sleepTest, (void*)sleepInfo, DEFAULT_PRI);
+    stopSystem();
+
+    // The spinner sinks while the sleeper comes back on top, so the sleeper
+    // runs on the tick it wakes up.
+    EXPECT_EQ(sleepInfo->ticksToSleep,
+              sleepInfo->tickWokenUp - sleepInfo->tickSleepStarted);
+    MlfqStats stats;
+    getMlfqStats(&stats);
+    EXPECT_GT(stats.demotions, 0);
+
+    destroyThread(spinThread);
+    destroyThread(sleepThread);
+    free(spinInfo);
+    free(sleepInfo);
+}
+
+TEST(Policies, MlfqYieldsAfterTheQuantumDoNotPromote) {
+    MlfqConfig config = {3, {1, 1, 1}, 0};
+    setMlfqConfig(&config);
+    startSystem("mlfq");
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    SpinInfo* spinInfo = (SpinInfo*)calloc(1, sizeof(SpinInfo));
+    spinInfo->ticksToSpin = 20;
+    Thread* spinThread = createAndSetThreadToRun(
+        "Spin", spinAndYield, (void*)spinInfo, DEFAULT_PRI);
+    stopSystem();
+    MlfqConfig defaults = {3, {1, 2, 4}, 50};
+    setMlfqConfig(&defaults);
+
+    // The thread only yields once it has run into a new tick, which is the
+    // last of a one tick quantum, so it keeps sinking instead of being moved
+    // back up each time.
+    MlfqStats stats;
+    getMlfqStats(&stats);
+    EXPECT_GT(stats.demotions, 0);
+    EXPECT_EQ(0, stats.promotions);
+
+    destroyThread(spinThread);
+    free(spinInfo);
+}
+
+TEST(Policies, TimeSlicesSaveSwitches) {
+    TimeSliceConfig config;
+    for (int x = 0; x < MAX_PRI - MIN_PRI + 1; x++) {
+        config.sliceTicks[x] = 1;
+    }
+    config.sliceTicks[0] = 4;
+    setTimeSliceConfig(&config);
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    SpinInfo* spinInfo = (SpinInfo*)calloc(2, sizeof(SpinInfo));
+    spinInfo[0].ticksToSpin = 16;
+    spinInfo[1].ticksToSpin = 16;
+    SleepInfo* sleepInfo = (SleepInfo*)calloc(1, sizeof(SleepInfo));
+    sleepInfo->ticksToSleep = 6;
+    Thread* firstThread = createAndSetThreadToRun(
+        "Batch 1", spinTest, (void*)&spinInfo[0], MIN_PRI);
+    Thread* secondThread = createAndSetThreadToRun(
+        "Batch 2", spinTest, (void*)&spinInfo[1], MIN_PRI);
+    Thread* sleepThread = createAndSetThreadToRun(
+        NAME_HI_PRI, sleepTest, (void*)sleepInfo, MAX_PRI);
+    stopSystem();
+    config.sliceTicks[0] = 1;
+    setTimeSliceConfig(&config);
+
+    // The batch threads take turns every four ticks instead of every tick,
+    // and run on through three of them without a context switch.
+    SchedulerStats stats;
+    getSchedulerStats(&stats);
+    EXPECT_GE(stats.continuations, 12);
+    // A long slice does not hold back a thread of higher priority.
+    EXPECT_EQ(sleepInfo->ticksToSleep,
+              sleepInfo->tickWokenUp - sleepInfo->tickSleepStarted);
+
+    destroyThread(firstThread);
+    destroyThread(secondThread);
+    destroyThread(sleepThread);
+    free(spinInfo);
+    free(sleepInfo);
+}
+
+TEST(Realtime, EdfMeetsDeadlines) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    SpinInfo* spinInfo = (SpinInfo*)calloc(1, sizeof(SpinInfo));
+    spinInfo->ticksToSpin = 20;
+    Thread* spinThread = createAndSetThreadToRun(NAME_HI_PRI, spinTest,
+                                                 (void*)spinInfo, MAX_PRI);
+    PeriodicInfo* periodicInfo = (PeriodicInfo*)malloc(sizeof(PeriodicInfo));
+    periodicInfo->numJobs = 4;
+    periodicInfo->jobStartTicks = (int*)calloc(4, sizeof(int));
+    RealtimeParams params = {4, 1, 2};
+    Thread* rtThread = createRealtimeTestThread(
+        "Periodic", periodicTest, (void*)periodicInfo, &params);
+    // Half of the CPU is taken, a thread wanting all of it must be turned
+    // away.
+    RealtimeParams tooMuch = {2, 2, 0};
+    Thread* rejected =
+        createRealtimeTestThread("Rejected", spinTest, NULL, &tooMuch);
+    stopSystem();
+
+    ASSERT_TRUE(rtThread != NULL);
+    EXPECT_TRUE(rejected == NULL);
+    // Every job runs within its deadline even though a maximum priority
+    // thread wants the CPU the whole time.
+    for (int x = 1; x < periodicInfo->numJobs; x++) {
+        int release = periodicInfo->jobStartTicks[0] + x * params.period;
+        EXPECT_GE(periodicInfo->jobStartTicks[x], release);
+        EXPECT_LT(periodicInfo->jobStartTicks[x], release + params.deadline);
+    }
+    EXPECT_LT(periodicInfo->jobStartTicks[periodicInfo->numJobs - 1],
+              spinInfo->tickFinished);
+    RealtimeThreadStats threadStats;
+    ASSERT_TRUE(getRealtimeThreadStats(rtThread, &threadStats));
+    EXPECT_EQ(0, threadStats.deadlineMisses);
+    RealtimeStats stats;
+    getRealtimeStats(&stats);
+    EXPECT_EQ(1, stats.admitted);
+    EXPECT_EQ(1, stats.rejected);
+
+    destroyThread(spinThread);
+    destroyThread(rtThread);
+    // The next thread may be given the freed record, but not its counters.
+    Thread* reused = allocateThread("Reused");
+    EXPECT_FALSE(getRealtimeThreadStats(reused, &threadStats));
+    freeThread(reused);
+    free(spinInfo);
+    free(periodicInfo->jobStartTicks);
+    free(periodicInfo);
+}
+
+TEST(Shutdown, StopsDuringDispatch) {
+    const int numThreads = 4;
+    startSystem();
+    SpinInfo spinInfo[numThreads];
+    Thread* threads[numThreads + 1];
+    for (int x = 0; x < numThreads; x++) {
+        spinInfo[x].ticksToSpin = 2 + x;
+        threads[x] = createAndSetThreadToRun("Spin", spinTest,
+                                             (void*)&spinInfo[x], DEFAULT_PRI);
+    }
+    SleepInfo sleepInfo;
+    sleepInfo.ticksToSleep = 8;
+    threads[numThreads] = createAndSetThreadToRun(
+        "Sleep", sleepTest, (void*)&sleepInfo, DEFAULT_PRI);
+    // Stop while the spinners are being dispatched and the sleeper is still
+    // waiting for its tick.
+    while (getCurrentTick() < 2) {
+        usleep(1000);
+    }
+    stopSystem();
+
+    SchedulerStats stats;
+    getSchedulerStats(&stats);
+    EXPECT_EQ(numThreads + 1, stats.threadsCreated);
+    for (int x = 0; x < numThreads; x++) {
+        EXPECT_EQ(TERMINATED, threads[x]->state);
+        EXPECT_GE(spinInfo[x].tickFinished - spinInfo[x].tickStarted,
+                  spinInfo[x].ticksToSpin);
+    }
+    EXPECT_EQ(TERMINATED, threads[numThreads]->state);
+    EXPECT_GE(sleepInfo.tickWokenUp,
+              sleepInfo.tickSleepStarted + sleepInfo.ticksToSleep);
+    for (int x = 0; x <= numThreads; x++) {
+        destroyThread(threads[x]);
+    }
+}
+
+TEST(Shutdown, StopsAfterThreadsEnded) {
+    startSystem();
+    SpinInfo spinInfo;
+    spinInfo.ticksToSpin = 1;
+    Thread* thread = createAndSetThreadToRun("Spin", spinTest,
+                                             (void*)&spinInfo, DEFAULT_PRI);
+    // Only empty ticks are left by the time stopSystem is called.
+    while (thread->state != TERMINATED) {
+        usleep(1000);
+    }
+    int endedTick = getCurrentTick();
+    while (getCurrentTick() < endedTick + 2) {
+        usleep(1000);
+    }
+    stopSystem();
+
+    SchedulerStats stats;
+    getSchedulerStats(&stats);
+    EXPECT_GE(stats.idleTicks, 2);
+    destroyThread(thread);
+}
+
+TEST(Shutdown, CreatesThreadsDuringIdleTicks) {
+    const int numCreators = 3;
+    const int perCreator = 4;
+    startSystem();
+    CreatorInfo creators[numCreators];
+    SpinInfo spinInfo[numCreators][perCreator];
+    Thread* threads[numCreators][perCreator];
+    pthread_t creatorThreads[numCreators];
+    for (int x = 0; x < numCreators; x++) {
+        creators[x].count = perCreator;
+        creators[x].spinInfo = spinInfo[x];
+        creators[x].threads = threads[x];
+        pthread_create(&creatorThreads[x], NULL, createSpinners,
+                       (void*)&creators[x]);
+    }
+    for (int x = 0; x < numCreators; x++) {
+        pthread_join(creatorThreads[x], NULL);
+    }
+    stopSystem();
+
+    // Every thread created from outside ran, whether the dispatcher was
+    // running another thread or idling when it arrived.
+    SchedulerStats stats;
+    getSchedulerStats(&stats);
+    EXPECT_EQ(numCreators * perCreator, stats.threadsCreated);
+    EXPECT_GT(stats.idleTicks, 0);
+    for (int x = 0; x < numCreators; x++) {
+        for (int y = 0; y < perCreator; y++) {
+            EXPECT_EQ(TERMINATED, threads[x][y]->state);
+            EXPECT_GE(spinInfo[x][y].tickFinished, spinInfo[x][y].tickStarted);
+            destroyThread(threads[x][y]);
+        }
+    }
+}
+
+TEST(Simulators, RunSideBySide) {
+    SimulatorRun runs[2];
+    pthread_t threads[2];
+    for (int x = 0; x < 2; x++) {
+        runs[x].simulator = createSimulator();
+        runs[x].numThreads = x + 2;
+        runs[x].ticksToSpin = 5;
+        pthread_create(&threads[x], NULL, runSimulator, (void*)&runs[x]);
+    }
+    for (int x = 0; x < 2; x++) {
+        pthread_join(threads[x], NULL);
+    }
+
+    // Each simulator only saw its own threads, and this thread still uses the
+    // default simulator.
+    for (int x = 0; x < 2; x++) {
+        EXPECT_EQ(x + 2, runs[x].stats.threadsCreated);
+        EXPECT_GE(runs[x].stats.ticks, runs[x].ticksToSpin);
+        EXPECT_GE(runs[x].stats.dispatches, x + 2);
+        EXPECT_TRUE(getCurrentSimulator() != runs[x].simulator);
+        destroySimulator(runs[x].simulator);
+    }
+}
+
+TEST(Simulators, HoldTheStudentCallbacksOneAtATime) {
+    Simulator* first = createSimulator();
+    Simulator* second = createSimulator();
+    setCurrentSimulator(first);
+    startSystem();
+
+    // The first simulator holds the callbacks, so the second cannot run the
+    // default policy and falls back to "cfs".
+    setCurrentSimulator(second);
+    startSystem();
+    SpinInfo spinInfo = {2, 0, 0};
+    Thread* thread = createAndSetThreadToRun("Spin", spinTest,
+                                             (void*)&spinInfo, DEFAULT_PRI);
+    stopSystem();
+    FairShareStats stats;
+    getFairShareStats(&stats);
+    destroyThread(thread);
+
+    setCurrentSimulator(first);
+    stopSystem();
+    setCurrentSimulator(NULL);
+    destroySimulator(second);
+    destroySimulator(first);
+    EXPECT_GT(stats.picks, 0);
+    EXPECT_GE(spinInfo.tickFinished, spinInfo.tickStarted);
+}
+
+const int REPLAY_TEST_THREADS = 3;
+const int REPLAY_TEST_TICKS = 6;
+const int REPLAY_TEST_CAPACITY = 64;
+
+// Runs threads that take turns spinning, so every slice but their last ends in
+// a preemption, and collects the order they saw the ticks in.
+static void runTickLoggers(int* order, int* length, SchedulerStats* stats) {
+    startSystem();
+#ifdef TEST_VERBOSE
+    setVerbose(true);
+#endif
+    TickLog* logs = (TickLog*)calloc(REPLAY_TEST_THREADS, sizeof(TickLog));
+    Thread** threads =
+        (Thread**)calloc(REPLAY_TEST_THREADS, sizeof(Thread*));
+    *length = 0;
+    for (int x = 0; x < REPLAY_TEST_THREADS; x++) {
+        logs[x].id = x;
+        logs[x].ticksToSpin = REPLAY_TEST_TICKS;
+        logs[x].capacity = REPLAY_TEST_CAPACITY;
+        logs[x].order = order;
+        logs[x].length = length;
+        threads[x] = createAndSetThreadToRun("Logger", logTicks,
+                                             (void*)&logs[x], DEFAULT_PRI);
+    }
+    stopSystem();
+    getSchedulerStats(stats);
+    for (int x = 0; x < REPLAY_TEST_THREADS; x++) {
+        destroyThread(threads[x]);
+    }
+    free(threads);
+    free(logs);
+}
+
+TEST(Replay, RepeatsPreemptedSlices) {
+    char path[] = "/tmp/schedule_trace_XXXXXX";
+    int file = mkstemp(path);
+    ASSERT_NE(-1, file);
+    close(file);
+    int recorded[REPLAY_TEST_CAPACITY];
+    int replayed[REPLAY_TEST_CAPACITY];
+    int recordedLength;
+    int replayedLength;
+    SchedulerStats recordStats;
+    SchedulerStats replayStats;
+    recordSchedule(path);
+    runTickLoggers(recorded, &recordedLength, &recordStats);
+    replaySchedule(path);
+    runTickLoggers(replayed, &replayedLength, &replayStats);
+    unlink(path);
+
+    // The threads took turns, so most of their slices were preempted.
+    int switches = 0;
+    for (int x = 1; x < recordedLength; x++) {
+        if (recorded[x] != recorded[x - 1])
+            switches++;
+    }
+    EXPECT_GE(switches, REPLAY_TEST_THREADS);
+    EXPECT_EQ(0, replayStats.replayDivergences);
+    EXPECT_EQ(recordStats.ticks, replayStats.ticks);
+    ASSERT_EQ(recordedLength, replayedLength);
+    for (int x = 0; x < recordedLength; x++) {
+        EXPECT_EQ(recorded[x], replayed[x]);
+    }
+}
+
+const int KERNEL_TEST_MAX_COUNT = 75;
+
+// Checks every kernel this CPU supports against the plain loops, on lengths
+// around each vector width so the leftover entries are covered too.
+static void expectKernelsMatch(const int* values,
+                               const uint8_t* states,
+                               int count) {
+    const Threading::ScanKernels* scalar = Threading::scalarScanKernels();
+    const Threading::ScanKernels* kernels[Threading::SCAN_KERNEL_SETS];
+    int supported = Threading::supportedScanKernels(kernels);
+    int expectedRows[KERNEL_TEST_MAX_COUNT];
+    int rows[KERNEL_TEST_MAX_COUNT];
+    int expectedArgmax = scalar->argmax(values, count);
+    int expectedSelected =
+        scalar->selectAtMost(values, states, 1, count, 3, expectedRows);
+    for (int x = 0; x < supported; x++) {
+        SCOPED_TRACE(kernels[x]->name);
+        SCOPED_TRACE(count);
+        EXPECT_EQ(expectedArgmax, kernels[x]->argmax(values, count));
+        int selected =
+            kernels[x]->selectAtMost(values, states, 1, count, 3, rows);
+        ASSERT_EQ(expectedSelected, selected);
+        for (int row = 0; row < selected; row++) {
+            EXPECT_EQ(expectedRows[row], rows[row]);
+        }
+    }
+}
+
+TEST(Kernels, MatchScalarLoops) {
+    int values[KERNEL_TEST_MAX_COUNT];
+    uint8_t states[KERNEL_TEST_MAX_COUNT];
+    srand(KERNEL_TEST_MAX_COUNT);
+    for (int count = 0; count <= KERNEL_TEST_MAX_COUNT; count++) {
+        for (int x = 0; x < count; x++) {
+            values[x] = rand() % 6;
+            states[x] = rand() % 3;
+        }
+        expectKernelsMatch(values, states, count);
+
+        // All-equal columns match every entry or none.
+        for (int x = 0; x < count; x++) {
+            values[x] = 2;
+            states[x] = 1;
+        }
+        expectKernelsMatch(values, states, count);
+        for (int x = 0; x < count; x++) {
+            values[x] = 5;
+        }
+        expectKernelsMatch(values, states, count);
+    }
+}
+
+TEST(Events, QueueWrapsAround) {
+    Threading::EventQueue queue;
+    Thread threads[2];
+    Threading::Event event;
+    // Three laps of the ring, a couple of events in flight at a time.
+    for (int x = 0; x < 3 * Threading::EVENT_QUEUE_CAPACITY; x += 2) {
+        Threading::Event first = {Threading::EVENT_CREATE, &threads[0], x};
+        Threading::Event second = {Threading::EVENT_PRIORITY, &threads[1],
+                                   x + 1};
+        ASSERT_TRUE(queue.push(first));
+        ASSERT_TRUE(queue.push(second));
+        ASSERT_TRUE(queue.pop(&event));
+        EXPECT_EQ(Threading::EVENT_CREATE, event.type);
+        EXPECT_EQ(&threads[0], event.thread);
+        EXPECT_EQ(x, event.priority);
+        ASSERT_TRUE(queue.pop(&event));
+        EXPECT_EQ(Threading::EVENT_PRIORITY, event.type);
+        EXPECT_EQ(x + 1, event.priority);
+    }
+    EXPECT_FALSE(queue.pop(&event));
+}
+
+TEST(Events, FullQueueRefusesPushes) {
+    Threading::EventQueue queue;
+    Threading::Event event = {Threading::EVENT_PRIORITY, NULL, 0};
+    for (int x = 0; x < Threading::EVENT_QUEUE_CAPACITY; x++) {
+        event.priority = x;
+        ASSERT_TRUE(queue.push(event));
+    }
+    event.priority = -1;
+    EXPECT_FALSE(queue.push(event));
+
+    // A pop frees one slot, and the events still come out in order.
+    Threading::Event popped;
+    ASSERT_TRUE(queue.pop(&popped));
+    EXPECT_EQ(0, popped.priority);
+    event.priority = Threading::EVENT_QUEUE_CAPACITY;
+    EXPECT_TRUE(queue.push(event));
+    EXPECT_FALSE(queue.push(event));
+    for (int x = 1; x <= Threading::EVENT_QUEUE_CAPACITY; x++) {
+        ASSERT_TRUE(queue.pop(&popped));
+        EXPECT_EQ(x, popped.priority);
+    }
+    EXPECT_FALSE(queue.pop(&popped));
+}
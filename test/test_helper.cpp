@@ -1,8 +1,11 @@
 #include "test_helper.h"
+#include <List.h>
 #include <Lock.h>
 #include <Logger.h>
 #include <Map.h>
+#include <Sync.h>
 #include <Thread.h>
+#include <unistd.h>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -139,7 +142,267 @@ void* donationPriority(void* arg) {
     unlock(donationInfo->lock);
 }
 
+void* nestedDonation(void* arg) {
+    NestedLockInfo* info = (NestedLockInfo*)arg;
+    lock(info->firstLock);
+    if (info->tcbi) {
+        info->created =
+            createAndSetThreadToRun(info->tcbi->threadName, info->tcbi->func,
+                                    info->tcbi->arg, info->tcbi->pri);
+    }
+    // The thread created above runs next; a thread with nothing more to lock
+    // steps aside so it can.
+    if (info->secondLock) {
+        lock(info->secondLock);
+    } else if (info->tcbi) {
+        stopExecutingThreadForCycle();
+    }
+    info->priorityHeld = getCurrentThread()->priority;
+    info->finishedAs = *(info->numThreadsFinished);
+    *(info->numThreadsFinished) = *(info->numThreadsFinished) + 1;
+    if (info->secondLock)
+        unlock(info->secondLock);
+    unlock(info->firstLock);
+    return NULL;
+}
+
+void* readWriteLocker(void* arg) {
+    ReadWriteInfo* info = (ReadWriteInfo*)arg;
+    ThreadCallbackInfo* tcbi = info->tcbi;
+    if (tcbi && info->createFirst) {
+        info->created = createAndSetThreadToRun(tcbi->threadName, tcbi->func,
+                                                tcbi->arg, tcbi->pri);
+    }
+    if (info->exclusive) {
+        lockExclusive(info->lock);
+    } else {
+        lockShared(info->lock);
+    }
+    // Let the thread created while holding the lock try it too.
+    if (tcbi && !info->createFirst) {
+        info->created = createAndSetThreadToRun(tcbi->threadName, tcbi->func,
+                                                tcbi->arg, tcbi->pri);
+        stopExecutingThreadForCycle();
+    }
+    info->priorityHeld = getCurrentThread()->priority;
+    info->finishedAs = *(info->numThreadsFinished);
+    *(info->numThreadsFinished) = *(info->numThreadsFinished) + 1;
+    if (info->exclusive) {
+        unlockExclusive(info->lock);
+    } else {
+        unlockShared(info->lock);
+    }
+    return NULL;
+}
+
+void* timedLockHolder(void* arg) {
+    TimedLockInfo* info = (TimedLockInfo*)arg;
+    lock(info->lock);
+    info->created =
+        createAndSetThreadToRun(info->tcbi->threadName, info->tcbi->func,
+                                info->tcbi->arg, info->tcbi->pri);
+    tickSleep(info->holdTicks);
+    info->releasedTick = getCurrentTick();
+    unlock(info->lock);
+    return NULL;
+}
+
+void* timedLockWaiter(void* arg) {
+    TimedLockInfo* info = (TimedLockInfo*)arg;
+    info->tryLocked = tryLock(info->lock);
+    info->waitStarted = getCurrentTick();
+    info->timedLocked = lockWithTimeout(info->lock, info->timeoutTicks);
+    info->waitEnded = getCurrentTick();
+    if (lockWithTimeout(info->lock, -1)) {
+        info->acquiredTick = getCurrentTick();
+        unlock(info->lock);
+    }
+    return NULL;
+}
+
+void* semaphoreWaiter(void* arg) {
+    SemaphoreInfo* info = (SemaphoreInfo*)arg;
+    if (info->tcbi) {
+        info->created =
+            createAndSetThreadToRun(info->tcbi->threadName, info->tcbi->func,
+                                    info->tcbi->arg, info->tcbi->pri);
+    }
+    semaphoreWait(info->semaphore);
+    info->finishedAs = *(info->numThreadsFinished);
+    *(info->numThreadsFinished) = *(info->numThreadsFinished) + 1;
+    return NULL;
+}
+
+void* semaphorePoster(void* arg) {
+    SemaphoreInfo* info = (SemaphoreInfo*)arg;
+    for (int x = 0; x < info->posts; x++) {
+        semaphorePost(info->semaphore);
+        stopExecutingThreadForCycle();
+    }
+    return NULL;
+}
+
+void* conditionConsumer(void* arg) {
+    ConditionInfo* info = (ConditionInfo*)arg;
+    lock(info->lock);
+    while (info->items < info->itemsWanted) {
+        waitCondition(info->condition, info->lock);
+        info->wakeups++;
+    }
+    unlock(info->lock);
+    return NULL;
+}
+
+void* conditionProducer(void* arg) {
+    ConditionInfo* info = (ConditionInfo*)arg;
+    for (int x = 0; x < info->itemsWanted; x++) {
+        lock(info->lock);
+        info->items++;
+        signalCondition(info->condition);
+        unlock(info->lock);
+        stopExecutingThreadForCycle();
+    }
+    return NULL;
+}
+
+void* conditionWaitUnlocked(void* arg) {
+    ConditionInfo* info = (ConditionInfo*)arg;
+    if (waitCondition(info->condition, info->lock))
+        info->wakeups++;
+    return NULL;
+}
+
 void* setMyPriorityTest(void* arg) {
     int* newPri = (int*)arg;
     setMyPriority(*newPri);
-}
\ No newline at end of file
+    // A thread sees its own change as soon as the call returns.
+    *newPri = getCurrentThread()->priority;
+    return NULL;
+}
+
+void* spinTest(void* arg) {
+    SpinInfo* spinInfo = (SpinInfo*)arg;
+    spinInfo->tickStarted = getCurrentTick();
+    while (getCurrentTick() < spinInfo->tickStarted + spinInfo->ticksToSpin) {
+    }
+    spinInfo->tickFinished = getCurrentTick();
+    return NULL;
+}
+
+// Spins like spinTest, but yields each time it has run into a new tick.
+void* spinAndYield(void* arg) {
+    SpinInfo* spinInfo = (SpinInfo*)arg;
+    spinInfo->tickStarted = getCurrentTick();
+    int now;
+    while ((now = getCurrentTick()) <
+           spinInfo->tickStarted + spinInfo->ticksToSpin) {
+        while (getCurrentTick() == now) {
+        }
+        stopExecutingThreadForCycle();
+    }
+    spinInfo->tickFinished = getCurrentTick();
+    return NULL;
+}
+
+// Spins like spinTest, adding its id to the shared order on every tick it
+// sees, so the order tells which thread ran on which tick.
+void* logTicks(void* arg) {
+    TickLog* log = (TickLog*)arg;
+    int started = getCurrentTick();
+    int seen = -1;
+    int now;
+    while ((now = getCurrentTick()) < started + log->ticksToSpin) {
+        if (now != seen && *log->length < log->capacity) {
+            log->order[(*log->length)++] = log->id;
+            seen = now;
+        }
+    }
+    return NULL;
+}
+
+void* joinTest(void* arg) {
+    JoinInfo* joinInfo = (JoinInfo*)arg;
+    joinInfo->firstEnded = joinAny(joinInfo->threads, joinInfo->count);
+    joinInfo->firstJoinedTick = getCurrentTick();
+    for (int x = 0; x < joinInfo->count; x++) {
+        joinThread(joinInfo->threads[x]);
+    }
+    joinInfo->lastJoinedTick = getCurrentTick();
+    return NULL;
+}
+
+void* periodicTest(void* arg) {
+    PeriodicInfo* periodicInfo = (PeriodicInfo*)arg;
+    for (int x = 0; x < periodicInfo->numJobs; x++) {
+        periodicInfo->jobStartTicks[x] = getCurrentTick();
+        if (x < periodicInfo->numJobs - 1)
+            waitForNextPeriod();
+    }
+    return NULL;
+}
+
+// Runs on a pthread of its own, so that several simulators run at once.
+void* runSimulator(void* arg) {
+    SimulatorRun* run = (SimulatorRun*)arg;
+    setCurrentSimulator(run->simulator);
+    startSystem("cfs");
+    SpinInfo* spinInfo = (SpinInfo*)calloc(run->numThreads, sizeof(SpinInfo));
+    Thread** threads = (Thread**)calloc(run->numThreads, sizeof(Thread*));
+    for (int x = 0; x < run->numThreads; x++) {
+        spinInfo[x].ticksToSpin = run->ticksToSpin;
+        threads[x] = createAndSetThreadToRun("Spin", spinTest,
+                                             (void*)&spinInfo[x], DEFAULT_PRI);
+    }
+    stopSystem();
+    getSchedulerStats(&run->stats);
+    for (int x = 0; x < run->numThreads; x++) {
+        destroyThread(threads[x]);
+    }
+    free(threads);
+    free(spinInfo);
+    return NULL;
+}
+
+// Runs outside the simulation and creates a thread about every one and a half
+// ticks, so creations land on ticks where nothing else is running.
+void* createSpinners(void* arg) {
+    CreatorInfo* info = (CreatorInfo*)arg;
+    for (int x = 0; x < info->count; x++) {
+        info->spinInfo[x].ticksToSpin = 1;
+        info->threads[x] = createAndSetThreadToRun(
+            "Spin", spinTest, (void*)&info->spinInfo[x], DEFAULT_PRI);
+        usleep(75000);
+    }
+    return NULL;
+}
+
+// The ready list of the scheduler in answer/thread.cpp.
+extern const char* readyList;
+
+void* joinLowerPriorityChild(void* arg) {
+    ReadyListInfo* info = (ReadyListInfo*)arg;
+    info->spinInfo.ticksToSpin = 1;
+    Thread* child = createAndSetThreadToRun("Child", spinTest,
+                                            (void*)&info->spinInfo, MIN_PRI);
+    joinThread(child);
+    // The child ran behind this thread, so only its own entry is left.
+    info->readyAfterJoin = listSize(readyList);
+    destroyThread(child);
+    return NULL;
+}
+
+Thread* createRealtimeTestThread(const char* name,
+                                 void* (*func)(void*),
+                                 void* arg,
+                                 const RealtimeParams* params) {
+    // Freed by destroyThread like any other thread, so it comes from the
+    // same arena.
+    Thread* thread = allocateThread(name);
+    thread->func = func;
+    thread->arg = arg;
+    if (!createRealtimeThread(thread, params)) {
+        freeThread(thread);
+        return NULL;
+    }
+    return thread;
+}
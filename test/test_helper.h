@@ -2,6 +2,9 @@
 #define PROJECT2_THREADING_TESTHELPER_H
 
 #include <pthread.h>
+#include "Scheduler.h"
+#include "Simulator.h"
+#include "Stats.h"
 #include "Thread.h"
 
 typedef struct ThreadCallbackInfo {
@@ -37,6 +40,51 @@ typedef struct SleepInfo {
     int tickWokenUp;
 } SleepInfo;
 
+typedef struct SpinInfo {
+    int ticksToSpin;
+    int tickStarted;
+    int tickFinished;
+} SpinInfo;
+
+typedef struct JoinInfo {
+    Thread** threads;
+    int count;
+    Thread* firstEnded;
+    int firstJoinedTick;
+    int lastJoinedTick;
+} JoinInfo;
+
+typedef struct PeriodicInfo {
+    int numJobs;
+    int* jobStartTicks;
+} PeriodicInfo;
+
+typedef struct SimulatorRun {
+    Simulator* simulator;
+    int numThreads;
+    int ticksToSpin;
+    SchedulerStats stats;
+} SimulatorRun;
+
+typedef struct ReadyListInfo {
+    SpinInfo spinInfo;
+    int readyAfterJoin;
+} ReadyListInfo;
+
+typedef struct TickLog {
+    int id;
+    int ticksToSpin;
+    int capacity;
+    int* order;
+    int* length;
+} TickLog;
+
+typedef struct CreatorInfo {
+    int count;
+    SpinInfo* spinInfo;
+    Thread** threads;
+} CreatorInfo;
+
 typedef struct ThreadLockInfo {
     Thread thread;
     bool lockHeld;
@@ -51,10 +99,83 @@ typedef struct DonationInfo {
     ThreadCallbackInfo* tcbi;
 } DonationInfo;
 
+typedef struct NestedLockInfo {
+    const char* firstLock;
+    const char* secondLock;
+    ThreadCallbackInfo* tcbi;
+    Thread* created;
+    int* numThreadsFinished;
+    int finishedAs;
+    int priorityHeld;
+} NestedLockInfo;
+
+typedef struct ReadWriteInfo {
+    const char* lock;
+    bool exclusive;
+    ThreadCallbackInfo* tcbi;
+    bool createFirst;
+    Thread* created;
+    int* numThreadsFinished;
+    int finishedAs;
+    int priorityHeld;
+} ReadWriteInfo;
+
+typedef struct TimedLockInfo {
+    const char* lock;
+    ThreadCallbackInfo* tcbi;
+    Thread* created;
+    int holdTicks;
+    int releasedTick;
+    bool tryLocked;
+    int timeoutTicks;
+    int waitStarted;
+    int waitEnded;
+    bool timedLocked;
+    int acquiredTick;
+} TimedLockInfo;
+
+typedef struct SemaphoreInfo {
+    const char* semaphore;
+    ThreadCallbackInfo* tcbi;
+    Thread* created;
+    int* numThreadsFinished;
+    int finishedAs;
+    int posts;
+} SemaphoreInfo;
+
+typedef struct ConditionInfo {
+    const char* lock;
+    const char* condition;
+    int itemsWanted;
+    int items;
+    int wakeups;
+} ConditionInfo;
+
 void* multiply(void* arg);
 void* recordThreadPriority(void* arg);
 void* sleepTest(void* arg);
 void* simpleLock(void* arg);
 void* donationPriority(void* arg);
+void* nestedDonation(void* arg);
+void* readWriteLocker(void* arg);
+void* timedLockHolder(void* arg);
+void* timedLockWaiter(void* arg);
+void* semaphoreWaiter(void* arg);
+void* semaphorePoster(void* arg);
+void* conditionConsumer(void* arg);
+void* conditionProducer(void* arg);
+void* conditionWaitUnlocked(void* arg);
 void* setMyPriorityTest(void* arg);
+void* spinTest(void* arg);
+void* spinAndYield(void* arg);
+void* joinTest(void* arg);
+void* periodicTest(void* arg);
+void* runSimulator(void* arg);
+void* createSpinners(void* arg);
+void* joinLowerPriorityChild(void* arg);
+void* logTicks(void* arg);
+Thread* createRealtimeTestThread(const char* name,
+                                 void* (*func)(void*),
+                                 void* arg,
+                                 const RealtimeParams* params);
 #endif  // PROJECT2_THREADING_TESTHELPER_H